@@ -11,12 +11,35 @@
 
 #define EEPROM_ADDR 0xA0
 
+// I2C driver commands, must match i2c_driver.spin
+#define I2C_CMD_READ    1
+#define I2C_CMD_WRITE   2
+
+// I2C driver mailbox, the driver reads the first five fields at startup
+typedef struct {
+    int sclPin;
+    int sdaPin;
+    uint32_t lowTicks;              // SCL low time
+    uint32_t highTicks;             // SCL high time
+    uint32_t busyTicks;             // how long to poll a busy device
+    uint32_t command;               // cleared by the driver when done
+    int32_t result;                 // bytes transferred or EEPROM_ERR_ code
+    uint32_t control;               // device select byte
+    uint32_t addr;                  // address within the 64K bank
+    uint8_t *buffer;
+    uint32_t count;
+} I2C_MAILBOX;
+
+static volatile I2C_MAILBOX i2cMailbox;
+static int i2cCog = -1;
+
 void eeprom_init(void)
 {
+    extern uint32_t binary_i2c_driver_dat_start[];
     int i;
 
-    OUTA = (1 << I2C_SCL);
-    DIRA = (1 << I2C_SCL);
+    OUTA |= (1 << I2C_SCL);
+    DIRA |= (1 << I2C_SCL);
 
     DIRA &= ~(1 << I2C_SDA);                       // Set SDA as input
     for (i = 0; i < 9; i++) {
@@ -25,53 +48,118 @@ void eeprom_init(void)
         if ((INA & (1 << I2C_SDA)) != 0)           // Repeat if SDA not driven high by the EEPROM
             break;
     }
+    DIRA &= ~(1 << I2C_SCL);                       // Leave SCL to the driver cog
+
+    i2cMailbox.sclPin = I2C_SCL;
+    i2cMailbox.sdaPin = I2C_SDA;
+    i2cMailbox.lowTicks = (_CLKFREQ / 1000000) * I2C_LOW_NS / 1000;
+    i2cMailbox.highTicks = (_CLKFREQ / 1000000) * I2C_HIGH_NS / 1000;
+    i2cMailbox.busyTicks = (_CLKFREQ / 1000) * EEPROM_BUSY_MS;
+    i2cMailbox.command = 0;
+    i2cCog = cognew(binary_i2c_driver_dat_start, (void *)&i2cMailbox);
 }
 
-int32_t eeprom_read(uint32_t addr, uint8_t * ptr, uint32_t count) {
+// Select the device and send the address. A device that is still
+// programming a page doesn't acknowledge its control byte, so keep
+// trying until it does or the write cycle time has passed.
+static int32_t eeprom_select(uint32_t addr) {
+    uint32_t control = EEPROM_ADDR | I2C_WRITE | ((addr & 0x10000) >> 15);
+    uint32_t start = CNT;
 
-    while (count > 0) {
-        i2c_start();                                    // Select the device & send address
-        i2c_write(EEPROM_ADDR | I2C_WRITE | ((addr & 0x10000) >> 15));
-        i2c_write(addr >> 8);
-        i2c_write(addr & 0xFF);
+    for (;;) {
+        i2c_start();
+        if (i2c_write(control) == I2C_ACK)
+            break;
+        i2c_stop();
+        if (CNT - start >= (_CLKFREQ / 1000) * EEPROM_BUSY_MS)
+            return EEPROM_ERR_BUSY;
+    }
 
-        i2c_start();                                    // Reselect the device for reading
-        i2c_write(EEPROM_ADDR | I2C_READ | ((addr & 0x10000) >> 15));
+    if (i2c_write(addr >> 8) != I2C_ACK || i2c_write(addr & 0xFF) != I2C_ACK) {
+        i2c_stop();
+        return EEPROM_ERR_NAK;
+    }
+
+    return 0;
+}
+
+// Read or write one block that doesn't cross a 64K bank, or a page when
+// writing. Returns count or a negative EEPROM_ERR_ code.
+static int32_t eeprom_transfer(int command, uint32_t addr, uint8_t * ptr, uint32_t count) {
+    uint32_t n;
+    int32_t ret;
+
+    if (i2cCog >= 0) {                                  // Hand the whole block to the driver
+        i2cMailbox.control = EEPROM_ADDR | I2C_WRITE | ((addr & 0x10000) >> 15);
+        i2cMailbox.addr = addr & 0xFFFF;
+        i2cMailbox.buffer = ptr;
+        i2cMailbox.count = count;
+        i2cMailbox.command = command;
+        while (i2cMailbox.command)
+            ;
+        return i2cMailbox.result;
+    }
 
-        addr++;
-        while (count > 1 && (addr & 0xFFFF) != 0) {
+    if ((ret = eeprom_select(addr)) < 0)                // Select the device & send address
+        return ret;
+
+    if (command == I2C_CMD_READ) {
+        i2c_start();                                    // Reselect the device for reading
+        if (i2c_write(EEPROM_ADDR | I2C_READ | ((addr & 0x10000) >> 15)) != I2C_ACK) {
+            i2c_stop();
+            return EEPROM_ERR_NAK;
+        }
+        for (n = 1; n < count; n++)
             *ptr++ = i2c_read(I2C_ACK);
-            count--;
-            addr++;
+        *ptr = i2c_read(I2C_NAK);
+    }
+    else {
+        for (n = 0; n < count; n++) {
+            if (i2c_write(*ptr++) != I2C_ACK) {
+                i2c_stop();
+                return EEPROM_ERR_NAK;
+            }
         }
-        *ptr++ = i2c_read(I2C_NAK);
-        count--;
-
-        i2c_stop();
     }
 
-    return 0;
+    i2c_stop();                                         // A write cycle starts here
+    return count;
 }
 
-int32_t eeprom_write(uint32_t addr, uint8_t * ptr, uint32_t count) {
+int32_t eeprom_read(uint32_t addr, uint8_t * ptr, uint32_t count) {
+    uint32_t total = count, n;
+    int32_t ret;
 
     while (count > 0) {
-        i2c_start();                                    // Select the device & send address
-        i2c_write(EEPROM_ADDR | I2C_WRITE | ((addr & 0x10000) >> 15));
-        i2c_write(addr >> 8);
-        i2c_write(addr & 0xFF);
+        n = 0x10000 - (addr & 0xFFFF);                  // One transaction per 64K bank
+        if (n > count)
+            n = count;
+        if ((ret = eeprom_transfer(I2C_CMD_READ, addr, ptr, n)) < 0)
+            return ret;
+        addr += n;
+        ptr += n;
+        count -= n;
+    }
 
-        do {
-            i2c_write(*ptr++);
-            addr++;
-            count--;
-        } while (count > 0 && (addr & 0x3F) != 0);
+    return total;
+}
 
-        i2c_stop();
-        waitcnt(CNT + ((_CLKFREQ / 1000) * 5));
+int32_t eeprom_write(uint32_t addr, uint8_t * ptr, uint32_t count) {
+    uint32_t total = count, n;
+    int32_t ret;
+
+    while (count > 0) {
+        n = EEPROM_PAGE_SIZE - (addr & (EEPROM_PAGE_SIZE - 1)); // One transaction per page
+        if (n > count)
+            n = count;
+        if ((ret = eeprom_transfer(I2C_CMD_WRITE, addr, ptr, n)) < 0)
+            return ret;
+        addr += n;
+        ptr += n;
+        count -= n;
     }
 
-    return 0;
+    return total;
 }
 
 // SDA goes HIGH to LOW with SCL HIGH
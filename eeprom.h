@@ -14,11 +14,35 @@
 #define I2C_SCL         28
 #define I2C_SDA         29
 
+// SCL phases of the I2C driver cog, 400kHz with the low phase above the
+// 1.3us minimum of the 24LC512
+#define I2C_LOW_NS      1400
+#define I2C_HIGH_NS     1100
+
 #define I2C_ACK         0
 #define I2C_NAK         1
 #define I2C_WRITE       0
 #define I2C_READ        1
 
+/*
+ * EEPROM write page size. 128 bytes for the 24LC512 on the Activity Board,
+ * 64 bytes for a 24LC256.
+ */
+#ifndef EEPROM_PAGE_SIZE
+#define EEPROM_PAGE_SIZE    128
+#endif
+
+/*
+ * Longest time to wait for the EEPROM to finish an internal write cycle.
+ */
+#define EEPROM_BUSY_MS      10
+
+/*
+ * Error codes returned by eeprom_read and eeprom_write.
+ */
+#define EEPROM_ERR_NAK      -1      // the device didn't acknowledge a byte
+#define EEPROM_ERR_BUSY     -2      // the device stayed busy too long
+
 #define HIGH_EEPROM_OFFSET(a)  ((uint32_t)(a) - 0xc0000000 + 0x8000)
 
 #ifdef __cplusplus
@@ -27,25 +51,35 @@ extern "C"
 #endif
 
 /**
- * Initializes EEPROM access.
+ * Initializes EEPROM access. Starts the I2C driver cog, or falls back to
+ * the slower bit-banged code below when no cog is free. Only one cog may
+ * access the EEPROM at a time.
  */
 void eeprom_init(void);
 
 /**
- * Writes a data block to the EEPROM.
+ * Reads a data block from the EEPROM.
  *
  * addr - EEPROM address
- * ptr - Pointer to the data block to write.
- * count - Number of bytes to write.
+ * ptr - Pointer to the data block to read into.
+ * count - Number of bytes to read.
+ *
+ * Returns the number of bytes read or a negative EEPROM_ERR_ code.
  */
 int32_t eeprom_read(uint32_t addr, uint8_t * ptr, uint32_t count);
 
 /**
- * Reads a data block from the EEPROM.
+ * Writes a data block to the EEPROM.
  *
  * addr - EEPROM address
- * ptr - Pointer to the data block to write to.
- * count - Number of bytes to read.
+ * ptr - Pointer to the data block to write.
+ * count - Number of bytes to write.
+ *
+ * The block is split at page boundaries so each page is written in one
+ * transaction. The last page may still be programming when this returns;
+ * the next read or write waits for it by polling for an ACK.
+ *
+ * Returns the number of bytes written or a negative EEPROM_ERR_ code.
  */
 int32_t eeprom_write(uint32_t addr, uint8_t * ptr, uint32_t count);
 
@@ -0,0 +1,93 @@
+/**
+ * @file effects.c
+ *
+ * @brief Registry of the effect engines selected by the preset number.
+ */
+
+#include "effects.h"
+#include "flicker.h"
+#include "fire.h"
+#include "ws2812.h"
+
+#define FLICKER_FRAME_MS    10
+#define FIRE_FRAME_MS       15
+
+static FLICKER_STATE flicker;
+
+static FIRE_STATE fire;
+static uint32_t firePalette[FIRE_PALETTE_SIZE];
+static uint32_t fireColor;
+static int fireType = -1;
+
+// split units of work evenly between the segments of a frame
+static void segmentRange(int units, int segment, int segments, int *first, int *last)
+{
+    *first = (units * segment) / segments;
+    *last = (units * (segment + 1)) / segments;
+}
+
+static void flickerInit(EFFECT_CONTEXT *ctx)
+{
+    flicker_init(&flicker, ctx->scratch, ctx->matrix, ctx->buffers);
+}
+
+static void flickerParams(EFFECT_CONTEXT *ctx, const EFFECT_SETTINGS *settings)
+{
+    // S is the speed, 99 changes every group on every frame
+    int rate = ((99 - settings->rate) * 10) / FLICKER_FRAME_MS;
+    flicker_params(&flicker, ctx->color, settings->pixelWidth, (settings->depth * 255) / 99, rate);
+}
+
+static int flickerRender(EFFECT_CONTEXT *ctx, uint32_t *buf, int segment)
+{
+    int first, last;
+    segmentRange(flicker.groups, segment, ctx->segments, &first, &last);
+    return flicker_render(&flicker, buf, ctx->type, &ctx->rng[segment], first, last);
+}
+
+static void fireInit(EFFECT_CONTEXT *ctx)
+{
+    fire_init(&fire, ctx->scratch, ctx->matrix);
+}
+
+static void fireParams(EFFECT_CONTEXT *ctx, const EFFECT_SETTINGS *settings)
+{
+    fire_params(&fire, 20 + (settings->depth * 80) / 99, 50 + (settings->rate * 150) / 99);
+
+    // only rebuild the palette when the color changes
+    if (ctx->color != fireColor || ctx->type != fireType) {
+        fire_palette(firePalette, ctx->type, ctx->color);
+        fireColor = ctx->color;
+        fireType = ctx->type;
+    }
+}
+
+// each column is a flame of its own so the columns are split between
+// segments, unless the native kernel is running and takes the whole frame
+static int fireRender(EFFECT_CONTEXT *ctx, uint32_t *buf, int segment)
+{
+    int first, last;
+    if (fire.kernel) {
+        if (segment != 0)
+            return 0;
+        first = 0;
+        last = fire.columns;
+    }
+    else
+        segmentRange(fire.columns, segment, ctx->segments, &first, &last);
+    if (first < last)
+        fire_frame(&fire, buf, firePalette, &ctx->rng[segment], first, last);
+    return (last - first) * fire.rows;
+}
+
+const EFFECT effects[EFFECT_COUNT] = {
+{   "flicker",  { 2, 21, 99 },  FLICKER_FRAME_MS,   flickerInit,    flickerParams,  flickerRender   },
+{   "fire",     { 1, 50, 50 },  FIRE_FRAME_MS,      fireInit,       fireParams,     fireRender      },
+};
+
+const EFFECT *effect_get(int preset)
+{
+    if (preset < 1 || preset > EFFECT_COUNT)
+        preset = 1;
+    return &effects[preset - 1];
+}
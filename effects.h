@@ -0,0 +1,63 @@
+/**
+ * @file effects.h
+ *
+ * @brief Registry of the effect engines selected by the preset number.
+ */
+
+#ifndef __EFFECTS_H__
+#define __EFFECTS_H__
+
+#include <stdint.h>
+#include "fastrand.h"
+#include "matrix.h"
+
+#define EFFECT_COUNT    2
+
+// most cogs that can share the rendering of a frame
+#define EFFECT_MAX_SEGMENTS 8
+
+// settings kept for each preset, in the 0 to 99 units shown on the LCD
+typedef struct {
+    int pixelWidth;
+    int depth;
+    int rate;
+} EFFECT_SETTINGS;
+
+// everything an effect needs to know about the strip, owned by the render cog
+typedef struct {
+    const MATRIX *matrix;   // layout of the LEDs
+    int type;           // color format of the chain (TYPE_xxx)
+    uint32_t color;     // base color in $RRGGBB form, already scaled by level
+    int buffers;        // frame buffers in rotation
+    uint8_t *scratch;   // working memory, at least 3 * width * height bytes
+    int scratchSize;
+    int segments;       // parts each frame is split into, one for each render cog
+    fastrand_t rng[EFFECT_MAX_SEGMENTS];    // random number state of each segment
+} EFFECT_CONTEXT;
+
+typedef struct {
+    const char *name;
+    EFFECT_SETTINGS defaults;
+    int frameMs;        // frame period
+
+    // called when the effect is selected
+    void (*init)(EFFECT_CONTEXT *ctx);
+
+    // called before the first frame and whenever a setting or ctx->color changes
+    void (*params)(EFFECT_CONTEXT *ctx, const EFFECT_SETTINGS *settings);
+
+    // renders one segment of a frame in wire order, returns the number of
+    // pixels written or 0 if buf already holds them. Every segment of a frame
+    // is rendered at the same time on its own cog so segments must not share
+    // pixels or state.
+    int (*render)(EFFECT_CONTEXT *ctx, uint32_t *buf, int segment);
+} EFFECT;
+
+extern const EFFECT effects[EFFECT_COUNT];
+
+/**
+ * Returns the effect for a preset number (1 to EFFECT_COUNT).
+ */
+const EFFECT *effect_get(int preset);
+
+#endif
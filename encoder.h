@@ -2,10 +2,162 @@
  * struct to pass data to the toggle cog driver
  */
 
+#ifndef __ENCODER_H__
+#define __ENCODER_H__
+
+#include <stdint.h>
+
+/*
+ * quadrature decoder table indexed by (lastState << 2) | thisState
+ * giving +1 for a clockwise step, -1 for counter-clockwise and 0 for
+ * no movement or an illegal transition
+ */
+#define ENCODER_QUAD_TABLE {    \
+     0, +1, -1,  0,             \
+    -1,  0,  0, +1,             \
+    +1,  0,  0, -1,             \
+     0, -1, +1,  0              \
+}
+
+/* the button must be stable this long before a change is accepted */
+#define ENCODER_BUTTON_DEBOUNCE_MS  10
+
+/* number of events the ring holds (must be a power of 2, see io_driver.spin) */
+#define ENCODER_EVENT_SIZE  16
+#define ENCODER_EVENT_MASK  (ENCODER_EVENT_SIZE - 1)
+
+enum {
+    ENCODER_EVENT_STEP,         /* count is the signed number of steps */
+    ENCODER_EVENT_PRESS,        /* button released before the long press time */
+    ENCODER_EVENT_LONG_PRESS    /* button held for the long press time */
+};
+
+struct encoder_event {
+    uint32_t time;      /* CNT when the event was detected */
+    int16_t type;
+    int16_t count;
+};
+
 struct encoder_mailbox {
     int pin;
     volatile int minValue;
     volatile int maxValue;
     volatile int value;
     volatile int wrap;
+    int buttonPin;
+    uint32_t longPressTicks;
+    uint32_t debounceTicks;     /* inputs must be stable this long */
+    uint32_t accelTicks;        /* steps closer than this are accelerated */
+    volatile uint32_t missedSteps;  /* illegal transitions seen */
+
+    /* single producer (the cog), single consumer event ring */
+    volatile uint32_t head;     /* written only by the cog */
+    volatile uint32_t tail;     /* written only by the consumer */
+    volatile struct encoder_event events[ENCODER_EVENT_SIZE];
+};
+
+/*
+ * quadrature decoder state
+ */
+struct encoder_decoder {
+    uint32_t debounceTicks;
+    uint32_t accelTicks;
+    unsigned int candidate;     /* last raw sample */
+    uint32_t candidateTime;     /* CNT when the raw sample last changed */
+    unsigned int state;         /* debounced state */
+    int direction;              /* direction of the last step */
+    uint32_t stepTime;          /* CNT of the last step */
+    uint32_t missed;            /* illegal transitions seen */
 };
+
+static inline void encoder_decoder_init(struct encoder_decoder *d, uint32_t now, unsigned int sample, uint32_t debounceTicks, uint32_t accelTicks)
+{
+    d->debounceTicks = debounceTicks;
+    d->accelTicks = accelTicks;
+    d->candidate = sample;
+    d->candidateTime = now;
+    d->state = sample;
+    d->direction = 0;
+    d->stepTime = now - accelTicks;
+    d->missed = 0;
+}
+
+/*
+ * feed one sample of the two encoder inputs taken at time now
+ * returns the signed number of steps to apply
+ */
+static inline int encoder_decode(struct encoder_decoder *d, uint32_t now, unsigned int sample)
+{
+    static const int quadTable[16] = ENCODER_QUAD_TABLE;
+    int step;
+
+    /* accept a new state only after it has been stable for debounceTicks */
+    if (sample != d->candidate) {
+        d->candidate = sample;
+        d->candidateTime = now;
+        return 0;
+    }
+    if (sample == d->state || now - d->candidateTime < d->debounceTicks)
+        return 0;
+
+    step = quadTable[(d->state << 2) | sample];
+    d->state = sample;
+
+    /* both inputs changed so the state in between was missed */
+    if (step == 0) {
+        ++d->missed;
+        step = 2 * d->direction;
+    }
+
+    /* speed up steps that keep going the same way quickly */
+    else if (step == d->direction && now - d->stepTime < d->accelTicks) {
+        if (now - d->stepTime < d->accelTicks >> 2)
+            step *= 4;
+        else
+            step *= 2;
+    }
+
+    if (step) {
+        d->direction = step > 0 ? 1 : -1;
+        d->stepTime = now;
+    }
+    return step;
+}
+
+/*
+ * add an event to the ring
+ * returns 0 if the ring is full
+ */
+static inline int encoder_put_event(volatile struct encoder_mailbox *m, uint32_t time, int type, int count)
+{
+    uint32_t head = m->head;
+    volatile struct encoder_event *event;
+    if (head - m->tail >= ENCODER_EVENT_SIZE)
+        return 0;
+    event = &m->events[head & ENCODER_EVENT_MASK];
+    event->time = time;
+    event->type = type;
+    event->count = count;
+    m->head = head + 1;     /* publish after the event is filled in */
+    return 1;
+}
+
+/*
+ * take the oldest event from the ring
+ * returns 0 if the ring is empty
+ */
+static inline int encoder_get_event(volatile struct encoder_mailbox *m, struct encoder_event *event)
+{
+    uint32_t tail = m->tail;
+    volatile struct encoder_event *next;
+    if (tail == m->head)
+        return 0;
+    next = &m->events[tail & ENCODER_EVENT_MASK];
+    event->time = next->time;
+    event->type = next->type;
+    event->count = next->count;
+    m->tail = tail + 1;     /* release the slot after it is copied */
+    return 1;
+}
+
+#endif
@@ -1,75 +1,82 @@
 /*
- * code to read a rotary encoder
+ * code to read a rotary encoder and its push button
  */
 
 #include <propeller.h>
 #include "encoder.h"
 
-// require this many samples to match before accepting a new value
-#define DEBOUNCE_TARGET 2000
-
 static _COGMEM unsigned int pin;
+static _COGMEM unsigned int buttonMask;
+static _COGMEM uint32_t buttonDebounceTicks;
 
-static _COGMEM unsigned int nextValue;
-static _COGMEM unsigned int nextCount;
-static _COGMEM unsigned int tempValue;
+static _COGMEM struct encoder_decoder decoder;
+static _COGMEM uint32_t now;
+static _COGMEM int step;
+static _COGMEM int value;
+static _COGMEM int pendingSteps;
 
-static _COGMEM unsigned int lastValue;
-static _COGMEM unsigned int thisValue;
+static _COGMEM unsigned int tempValue;
+static _COGMEM unsigned int nextButton;
+static _COGMEM uint32_t nextButtonTime;
+static _COGMEM unsigned int buttonDown;
+static _COGMEM unsigned int longPressSent;
+static _COGMEM uint32_t pressTime;
 
 _NATIVE void main(volatile struct encoder_mailbox *m)
 {
     pin = m->pin;
+    buttonMask = 1 << m->buttonPin;
+    buttonDebounceTicks = ENCODER_BUTTON_DEBOUNCE_MS * (CLKFREQ / 1000);
 
-    nextValue = -1;
-    nextCount = 0;
+    now = CNT;
+    encoder_decoder_init(&decoder, now, (INA >> pin) & 3, m->debounceTicks, m->accelTicks);
 
-    lastValue = 0;
     m->value = 0;
+    m->missedSteps = 0;
+    pendingSteps = 0;
+
+    nextButton = 0;
+    nextButtonTime = now;
+    buttonDown = 0;
 
     for (;;) {
 
-        tempValue = (INA >> pin) & 3;
+        now = CNT;
 
-        if (tempValue == nextValue) {
-            if (++nextCount >= DEBOUNCE_TARGET) {
-                thisValue = nextValue;
-                nextCount = 0;
-            }
-        }
-        else {
-            nextValue = tempValue;
-            nextCount = 0;
+        if ((step = encoder_decode(&decoder, now, (INA >> pin) & 3)) != 0) {
+            value = m->value + step;
+            if (value > m->maxValue)
+                value = m->wrap ? m->minValue : m->maxValue;
+            else if (value < m->minValue)
+                value = m->wrap ? m->maxValue : m->minValue;
+            m->value = value;
+            m->missedSteps = decoder.missed;
+            pendingSteps += step;
         }
 
-        switch ((lastValue << 2) | thisValue) {
-        case 0b0000:    // no movement
-        case 0b0101:
-        case 0b1111:
-        case 0b1010:
-            // nothing to do
-            break;
-        case 0b0001:    // clockwise
-        case 0b0111:
-        case 0b1110:
-        case 0b1000:
-            if (m->value < m->maxValue)
-                ++m->value;
-            else if (m->wrap)
-                m->value = m->minValue;
-            break;
-        case 0b0010:    // counter-clockwise
-        case 0b1011:
-        case 0b1101:
-        case 0b0100:
-            if (m->value > m->minValue)
-                --m->value;
-            else if (m->wrap)
-                m->value = m->maxValue;
-            break;
+        // steps that don't fit in the ring are merged into the next event
+        if (pendingSteps != 0 && encoder_put_event(m, now, ENCODER_EVENT_STEP, pendingSteps))
+            pendingSteps = 0;
+
+        tempValue = (INA & buttonMask) != 0;
+
+        if (tempValue != nextButton) {
+            nextButton = tempValue;
+            nextButtonTime = now;
+        }
+        else if (tempValue != buttonDown && now - nextButtonTime >= buttonDebounceTicks) {
+            buttonDown = tempValue;
+            if (buttonDown) {
+                pressTime = now;
+                longPressSent = 0;
+            }
+            else if (!longPressSent)
+                encoder_put_event(m, now, ENCODER_EVENT_PRESS, 0);
         }
 
-        lastValue = thisValue;
+        if (buttonDown && !longPressSent && now - pressTime >= m->longPressTicks) {
+            encoder_put_event(m, now, ENCODER_EVENT_LONG_PRESS, 0);
+            longPressSent = 1;
+        }
     }
 }
-
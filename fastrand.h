@@ -0,0 +1,41 @@
+/**
+ * @file fastrand.h
+ *
+ * @brief Small division-free pseudo-random number generator.
+ *
+ * The Propeller has no hardware divide so rand() % n is expensive. This is
+ * a xorshift32 generator with a multiply-shift range reduction. Each cog
+ * should keep its own state.
+ */
+
+#ifndef __FASTRAND_H__
+#define __FASTRAND_H__
+
+#include <stdint.h>
+
+// generator state (never zero)
+typedef uint32_t fastrand_t;
+
+static inline void fastrand_seed(fastrand_t *state, uint32_t seed)
+{
+    *state = seed ? seed : 0x2545f491;
+}
+
+static inline uint32_t fastrand(fastrand_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// returns a number from 0 to n - 1 (n up to 65536), or 0 if n <= 0
+static inline int fastrand_range(fastrand_t *state, int n)
+{
+    if (n <= 0)
+        return 0;
+    return ((fastrand(state) >> 16) * (uint32_t)n) >> 16;
+}
+
+#endif
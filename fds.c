@@ -15,26 +15,22 @@
 #include "fds.h"
 
 /**
- * start initializes and starts native assembly driver in a cog.
+ * init sets up the interface struct without starting a cog.
  * @param rxpin is pin number for receive input
  * @param txpin is pin number for transmit output
  * @param mode is interface mode. see header FDSERIAL_MODE_...
  * @param baudrate is frequency of bits ... 115200, 57600, etc...
- * @returns non-zero on success
  */
-int FdSerial_start(FdSerial_t *data, int rxpin, int txpin, int mode, int baudrate)
+void FdSerial_init(FdSerial_t *data, int rxpin, int txpin, int mode, int baudrate)
 {
-    use_cog_driver(FullDuplexSerial);
-
     memset(data, 0, sizeof(FdSerial_t));
     data->rx_pin  = rxpin;                  // receive pin
     data->tx_pin  = txpin;                  // transmit pin
     data->mode    = mode;                   // interface mode
     data->ticks   = _clkfreq / baudrate;    // baud
-    data->buffptr = (int)&data->rxbuff[0];
-    data->cogId = load_cog_driver(FullDuplexSerial, data);
-
-    return data->cogId;
+    data->buffptr = (int)(intptr_t)&data->rxbuff[0];
+    data->buffmask = FDSERIAL_BUFF_MASK;
+    data->cogId = -1;
 }
 
 /**
@@ -75,7 +71,7 @@ int FdSerial_rx(FdSerial_t *term)
 int FdSerial_tx(FdSerial_t *term, int txbyte)
 {
   int rc = -1;
-  char* txbuf = (char*) term->buffptr + FDSERIAL_BUFF_MASK+1;
+  volatile char* txbuf = term->txbuff;
 
   while(term->tx_tail == ((term->tx_head+1) & FDSERIAL_BUFF_MASK))
       ; // wait for queue to be empty
@@ -84,6 +80,48 @@ int FdSerial_tx(FdSerial_t *term, int txbyte)
   return rc;
 }
 
+/*
+ * txfree gets the number of bytes that can be queued without blocking.
+ * @returns free space in the transmit queue
+ */
+int FdSerial_txfree(FdSerial_t *term)
+{
+  return (term->tx_tail - term->tx_head - 1) & FDSERIAL_BUFF_MASK;
+}
+
+/*
+ * try_write queues as many bytes as fit in the transmit queue.
+ * @returns number of bytes queued 
+ */
+int FdSerial_try_write(FdSerial_t *term, const char *buf, int len)
+{
+  volatile char* txbuf = term->txbuff;
+  int head = term->tx_head;
+  int count = FdSerial_txfree(term);
+  int i;
+
+  if(count > len)
+      count = len;
+  for(i = 0; i < count; i++) {
+      txbuf[head] = buf[i];
+      head = (head+1) & FDSERIAL_BUFF_MASK;
+  }
+  term->tx_head = head; // publish after the bytes are in place
+  return count;
+}
+
+/*
+ * write queues bytes, waiting for room when the transmit queue is full.
+ * @returns number of bytes queued 
+ */
+int FdSerial_write(FdSerial_t *term, const char *buf, int len)
+{
+  int sent = 0;
+  while(sent < len)
+      sent += FdSerial_try_write(term, buf + sent, len - sent);
+  return sent;
+}
+
 /**
  * Gets a byte from the receive queue if available
  * Function does not block. We move rxtail after getting char.
@@ -93,7 +131,7 @@ int FdSerial_rxcheck(FdSerial_t *data)
 {
     int rc = -1;
     if(data->rx_tail != data->rx_head) {
-        rc = data->rxbuff[data->rx_tail];
+        rc = (uint8_t)data->rxbuff[data->rx_tail];
         data->rx_tail = (data->rx_tail+1) & FDSERIAL_BUFF_MASK;
     }
     return rc;
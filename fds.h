@@ -9,9 +9,13 @@
 #define __FDSerial__
 
 /**
- * Defines buffer length. hard coded in asm driver ... s/b bigger
+ * Defines buffer length. Must be a power of 2. The asm driver reads the
+ * mask from the interface struct so this is the only place it is set.
  */
-#define FDSERIAL_BUFF_MASK 0xf
+#ifndef FDSERIAL_BUFF_SIZE
+#define FDSERIAL_BUFF_SIZE 64
+#endif
+#define FDSERIAL_BUFF_MASK (FDSERIAL_BUFF_SIZE-1)
 
 /**
  * Defines mode bits
@@ -26,9 +30,9 @@
 
 /**
  * Defines FdSerial interface struct
- * 9 contiguous longs + buffers + COG ID
- * These buffers must be contiguous. Their size must match the asm expectation.
- * Asm also expects the address of txbuff to be after rxbuff.
+ * 10 contiguous longs + buffers + COG ID
+ * These buffers must be contiguous. Asm reads their size from buffmask
+ * and expects the address of txbuff to be after rxbuff.
  */
 typedef struct FdSerial_struct
 {
@@ -41,6 +45,7 @@ typedef struct FdSerial_struct
     int mode;      // interface mode
     int ticks;     // clkfreq / baud
     int buffptr;   // pointer to rx buffer
+    int buffmask;  // buffer length - 1
     char rxbuff[FDSERIAL_BUFF_MASK+1];  // receive buffer
     char txbuff[FDSERIAL_BUFF_MASK+1];  // transmit buffer
     int cogId;     // cog flag/id
@@ -55,6 +60,15 @@ typedef struct FdSerial_struct
  * @returns non-zero on success
  */
 int FdSerial_start(FdSerial_t *data, int rxpin, int txpin, int mode, int baudrate);
+/**
+ * init sets up the interface struct without starting a cog, for drivers
+ * that run the serial port alongside other work. see io.h
+ * @param rxpin is pin number for receive input
+ * @param txpin is pin number for transmit output
+ * @param mode is interface mode
+ * @param baudrate is frequency of bits ... 115200, 57600, etc...
+ */
+void FdSerial_init(FdSerial_t *data, int rxpin, int txpin, int mode, int baudrate);
 /**
  * stop stops the cog running the native assembly driver 
  */
@@ -87,6 +101,26 @@ int FdSerial_rx(FdSerial_t *data);
  * @returns waits for and returns received byte if mode is 8 
  */
 int FdSerial_tx(FdSerial_t *data, int txbyte);
+/**
+ * txfree gets the number of bytes that can be queued without blocking.
+ * @returns free space in the transmit queue
+ */
+int FdSerial_txfree(FdSerial_t *data);
+/**
+ * try_write queues as many bytes as fit in the transmit queue.
+ * function does not block.
+ * @param buf is the bytes to send.
+ * @param len is the number of bytes to send.
+ * @returns number of bytes queued 
+ */
+int FdSerial_try_write(FdSerial_t *data, const char *buf, int len);
+/**
+ * write queues bytes, waiting for room in the transmit queue when it is full.
+ * @param buf is the bytes to send.
+ * @param len is the number of bytes to send.
+ * @returns number of bytes queued 
+ */
+int FdSerial_write(FdSerial_t *data, const char *buf, int len);
 
 #endif 
 
@@ -0,0 +1,31 @@
+/**
+ * @file fds_start.c
+ * Starts the Full Duplex Serial driver in a cog of its own. Kept apart
+ * from fds.c so builds that run the port from the I/O cog don't link
+ * the driver image.
+ *
+ * Copyright (c) 2008, Steve Denson
+ * See the end of fds.h for terms of use.
+ */
+#include <stdint.h>
+#include <propeller.h>
+
+#include "fds.h"
+
+/**
+ * start initializes and starts native assembly driver in a cog.
+ * @param rxpin is pin number for receive input
+ * @param txpin is pin number for transmit output
+ * @param mode is interface mode. see header FDSERIAL_MODE_...
+ * @param baudrate is frequency of bits ... 115200, 57600, etc...
+ * @returns non-zero on success
+ */
+int FdSerial_start(FdSerial_t *data, int rxpin, int txpin, int mode, int baudrate)
+{
+    extern uint32_t binary_fds_driver_dat_start[];
+
+    FdSerial_init(data, rxpin, txpin, mode, baudrate);
+    data->cogId = cognew(binary_fds_driver_dat_start, data);
+
+    return data->cogId;
+}
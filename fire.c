@@ -0,0 +1,89 @@
+/**
+ * @file fire.c
+ *
+ * @brief Heat diffusion flame engine.
+ */
+
+#include <string.h>
+#include "fire.h"
+#include "pixel.h"
+#include "ws2812.h"
+
+// native kernel handed to each engine as it is initialized
+static FIRE_KERNEL *fireKernel;
+
+void fire_use_kernel(FIRE_KERNEL *kernel)
+{
+    fireKernel = kernel;
+}
+
+void fire_init(FIRE_STATE *fire, uint8_t *heat, const MATRIX *matrix)
+{
+    fire->heat = heat;
+    fire->map = matrix->map;
+    fire->kernel = fireKernel;
+    if (matrix->height > 1) {
+        fire->columns = matrix->width;
+        fire->rows = matrix->height;
+        fire->stride = matrix->width;
+    }
+    else {
+        fire->columns = 1;
+        fire->rows = matrix->width;
+        fire->stride = 1;
+    }
+    fire->sparkRows = (fire->rows >> 3) + 1;
+    fire_params(fire, 55, 120);
+    memset(heat, 0, fire->columns * fire->rows);
+}
+
+void fire_params(FIRE_STATE *fire, int cooling, int sparking)
+{
+    // short columns need to cool faster per cell to give the same flame height
+    fire->coolMax = (cooling * 10) / fire->rows + 2;
+    fire->sparking = sparking;
+}
+
+void fire_frame(FIRE_STATE *fire, uint32_t *buf, const uint32_t *palette, fastrand_t *rng, int first, int last)
+{
+    volatile FIRE_KERNEL *kernel = fire->kernel;
+
+    // hand the columns to the native kernel and wait for it
+    if (kernel) {
+        kernel->fire = fire;
+        kernel->buf = buf;
+        kernel->palette = palette;
+        kernel->first = first;
+        kernel->last = last;
+        kernel->busy = 1;
+        while (kernel->busy)
+            ;
+        return;
+    }
+
+    fire_step(fire, rng, first, last);
+    fire_render(fire, buf, palette, first, last);
+}
+
+void fire_palette(uint32_t *palette, int type, uint32_t color)
+{
+    uint32_t r = (color >> 16) & 0xff;
+    uint32_t g = (color >> 8) & 0xff;
+    uint32_t b = color & 0xff;
+    uint32_t hot, c;
+    int i;
+
+    // the hottest cells are white at the brightness of the brightest channel
+    hot = r > g ? r : g;
+    if (b > hot)
+        hot = b;
+    hot = pixel_splat(hot);
+
+    for (i = 0; i < FIRE_PALETTE_SIZE; ++i) {
+        if (i < 128)
+            c = pixel_scale(color, i << 1);
+        else
+            c = pixel_blend(color, hot, (i - 128) << 1);
+        palette[i] = ws2812_pixel(type, c);
+    }
+}
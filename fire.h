@@ -0,0 +1,148 @@
+/**
+ * @file fire.h
+ *
+ * @brief Heat diffusion flame engine.
+ *
+ * Each cell keeps a heat byte. Every step the cells cool a little, heat
+ * drifts upward and new sparks are lit near the bottom. Heat is turned into
+ * a color by looking it up in a 256 entry palette.
+ *
+ * On a single row the strip is treated as one column rising from LED 0.
+ * On a matrix every column of rows rises from row 0.
+ */
+
+#ifndef __FIRE_H__
+#define __FIRE_H__
+
+#include <stdint.h>
+#include "fastrand.h"
+#include "matrix.h"
+
+#define FIRE_PALETTE_SIZE   256
+
+typedef struct {
+    uint8_t *heat;      // columns * rows cells, one column after another
+    int columns;
+    int rows;
+    const uint16_t *map;    // strip position of each cell, see matrix.h
+    int stride;         // distance between rows in the map
+    int coolMax;        // most heat a cell loses in one step
+    int sparking;       // chance of a new spark (0 to 255)
+    int sparkRows;      // rows at the bottom where sparks are lit
+    struct FIRE_KERNEL *kernel; // native kernel or NULL
+} FIRE_STATE;
+
+// mailbox of the native kernel in fire_fw.c
+typedef struct FIRE_KERNEL {
+    FIRE_STATE *fire;
+    uint32_t *buf;
+    const uint32_t *palette;
+    int first;          // columns to step and render
+    int last;
+    volatile int busy;  // set to start a frame, cleared by the kernel when done
+    fastrand_t rng;     // random number state of the kernel
+} FIRE_KERNEL;
+
+/**
+ * Initializes the engine for a matrix layout. Each column of the matrix
+ * is a flame, a single strip is one flame along its length.
+ *
+ * fire - Engine state.
+ * heat - Heat cells, width * height bytes.
+ * matrix - Layout of the LEDs.
+ */
+void fire_init(FIRE_STATE *fire, uint8_t *heat, const MATRIX *matrix);
+
+/**
+ * Sets how fast cells cool (0 to 255) and how often sparks are lit (0 to 255).
+ */
+void fire_params(FIRE_STATE *fire, int cooling, int sparking);
+
+/**
+ * Steps and renders columns first up to but not including last of a
+ * frame, on the native kernel if one is running. Cogs can render
+ * separate ranges of columns at the same time when there is no kernel.
+ *
+ * rng - Random number state of the calling cog.
+ */
+void fire_frame(FIRE_STATE *fire, uint32_t *buf, const uint32_t *palette, fastrand_t *rng, int first, int last);
+
+/**
+ * Hands the frames of engines initialized after this to a running native
+ * kernel, or back to the calling cog if kernel is NULL.
+ */
+void fire_use_kernel(FIRE_KERNEL *kernel);
+
+/**
+ * Starts the native kernel built from fire_fw.c on its own cog and calls
+ * fire_use_kernel. Propeller only, see fire_kernel.c.
+ *
+ * kernel - Mailbox of the kernel.
+ * code - Cog image of the kernel.
+ * seed - Random seed of the kernel.
+ *
+ * Returns the cog number or -1 if no cog was free.
+ */
+int fire_kernel_start(FIRE_KERNEL *kernel, void *code, uint32_t seed);
+
+/**
+ * Advances columns first up to but not including last by one frame.
+ * Inline so the native kernel is built from the same code.
+ *
+ * rng - Random number state of the calling cog.
+ */
+static inline void fire_step(FIRE_STATE *fire, fastrand_t *rng, int first, int last)
+{
+    int rows = fire->rows;
+    uint8_t *h = fire->heat + first * rows;
+    int x, y;
+
+    for (x = first; x < last; ++x, h += rows) {
+
+        // cool every cell a little
+        for (y = 0; y < rows; ++y) {
+            int cool = fastrand_range(rng, fire->coolMax);
+            h[y] = h[y] > cool ? h[y] - cool : 0;
+        }
+
+        // heat drifts up and diffuses (x * 171 >> 9 is about x / 3)
+        for (y = rows - 1; y >= 2; --y)
+            h[y] = ((h[y - 1] + h[y - 2] + h[y - 2]) * 171) >> 9;
+
+        // light a new spark near the bottom
+        if (fastrand_range(rng, 256) < fire->sparking) {
+            int spark = 160 + fastrand_range(rng, 96);
+            y = fastrand_range(rng, fire->sparkRows);
+            spark += h[y];
+            h[y] = spark > 255 ? 255 : spark;
+        }
+    }
+}
+
+/**
+ * Maps the heat cells of columns first up to but not including last
+ * through a palette into a frame buffer.
+ */
+static inline void fire_render(FIRE_STATE *fire, uint32_t *buf, const uint32_t *palette, int first, int last)
+{
+    const uint8_t *h = fire->heat + first * fire->rows;
+    int x, y;
+    for (x = first; x < last; ++x) {
+        const uint16_t *p = fire->map + x;
+        for (y = 0; y < fire->rows; ++y) {
+            buf[*p] = palette[*h++];
+            p += fire->stride;
+        }
+    }
+}
+
+/**
+ * Builds a palette that goes from black through color to a white hot core.
+ *
+ * palette - FIRE_PALETTE_SIZE entries in wire order.
+ * type - Color format of the chain (TYPE_xxx).
+ * color - Flame color in $RRGGBB form.
+ */
+void fire_palette(uint32_t *palette, int type, uint32_t color);
+
+#endif
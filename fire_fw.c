@@ -0,0 +1,24 @@
+/*
+ * native fire kernel, steps and renders frames for the render cog
+ *
+ * The simulation runs through the CMM interpreter several times slower
+ * than cog code so this builds the same inline code from fire.h with
+ * -mcog and runs it on a cog of its own.
+ */
+
+#include <propeller.h>
+#include "fire.h"
+
+_NATIVE void main(volatile FIRE_KERNEL *k)
+{
+    for (;;) {
+
+        // wait for the render cog to post a frame
+        while (!k->busy)
+            ;
+
+        fire_step(k->fire, (fastrand_t *)&k->rng, k->first, k->last);
+        fire_render(k->fire, k->buf, k->palette, k->first, k->last);
+        k->busy = 0;
+    }
+}
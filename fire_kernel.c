@@ -0,0 +1,19 @@
+/**
+ * @file fire_kernel.c
+ *
+ * @brief Starts the native fire kernel, kept apart so fire.c builds on the host.
+ */
+
+#include <string.h>
+#include <propeller.h>
+#include "fire.h"
+
+int fire_kernel_start(FIRE_KERNEL *kernel, void *code, uint32_t seed)
+{
+    int cog;
+    memset(kernel, 0, sizeof(FIRE_KERNEL));
+    fastrand_seed(&kernel->rng, seed);
+    if ((cog = cognew(code, kernel)) >= 0)
+        fire_use_kernel(kernel);
+    return cog;
+}
@@ -1,10 +1,21 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
 #include <propeller.h>
 #include "fds.h"
 #include "encoder.h"
 #include "ws2812.h"
 #include "eeprom.h"
+#include "matrix.h"
+#include "effects.h"
+#include "sched.h"
+#include "lcd.h"
+#include "io.h"
+#include "store.h"
+#include "persist.h"
+#include "render.h"
+#include "fire.h"
 
 #define RGB_LED_PIN         0
 
@@ -20,24 +31,54 @@
 #define BUTTON_PIN		    14
 #define BLUE_LED_PIN	    15
 
-#if 1
+#define LED_TYPE_WS2812B    0
+#define LED_TYPE_SK6812     1
+#define LED_TYPE_COUNT      2
+
+// geometry used until the setup page changes it
 #define RGB_ROW_WIDTH       144
 #define RGB_PIXEL_HEIGHT    1
-#else
-#define RGB_ROW_WIDTH       28
-#define RGB_PIXEL_HEIGHT    5
+#define RGB_WIRING          MATRIX_ROWS
+#define RGB_LED_TYPE        LED_TYPE_WS2812B
+
+// the LED buffers are carved at boot from a static arena sized for the
+// largest installation: two frame buffers, the matrix table and the effect
+// scratch memory for each LED
+#define LED_ARENA_LEDS      300
+#define LED_BYTES           (2 * sizeof(uint32_t) + sizeof(uint16_t) + 3)
+
+// run the LCD serial port, encoder and button in one cog, the Makefile
+// passes its own setting so it links only the drivers that are used
+#ifndef USE_IO_COG
+#define USE_IO_COG          1
 #endif
 
-#define RGB_LED_COUNT       (RGB_ROW_WIDTH * RGB_PIXEL_HEIGHT)
+// run the fire simulation as native code on a cog of its own, set by the
+// Makefile like USE_IO_COG
+#ifndef USE_FIRE_COG
+#define USE_FIRE_COG        1
+#endif
 
-enum {
-    LCD_CLEAR               = 0x0c,
-    LCD_BACKLIGHT_ON        = 0x11,
-    LCD_BACKLIGHT_OFF       = 0x12,
-    LCD_CURSOR_OFF_NO_BLINK = 0x16,
-    LCD_CURSOR_OFF_BLINK    = 0x17,
-    LCD_MOVE_CURSOR         = 0x80
-};
+// cogs sharing the rendering of each frame, the render cog included: the
+// main, render, LED, EEPROM and persist cogs always run, the I/O cog or the
+// serial and encoder cogs and the fire cog when it is used, and the rest of
+// the 8 go to render workers. That is 2 with USE_IO_COG and USE_FIRE_COG,
+// 3 without the fire cog, 2 with neither and 1 with the fire cog but not
+// the I/O cog.
+#define FIXED_COGS          (5 + (USE_IO_COG ? 1 : 2) + (USE_FIRE_COG ? 1 : 0))
+#define RENDER_COGS         (8 - FIXED_COGS + 1)
+
+// print the average cycles spent rendering a frame this often, 0 for never,
+// make REPORT_MS=1000 turns it on
+#ifndef REPORT_MS
+#define REPORT_MS           0
+#endif
+
+#define LONG_PRESS_MS       1000
+#define SAVE_IDLE_MS        2000    // save settings once left alone this long
+#define SAVE_MAX_MS         10000   // but no later than this after a change
+#define ENCODER_DEBOUNCE_US 100     // steps down to 150us still count, see encoder_test
+#define ENCODER_ACCEL_MS    40      // faster steps move in bigger jumps
 
 #define STACK_SIZE 16
 
@@ -58,20 +99,24 @@ struct par encoder;
 #define LOAD_START(fw)      _load_start_ ## fw ## _cog
 
 usefw(encoder_fw);
+usefw(fire_fw);
 
 typedef struct {
-    uint32_t *buf;
-    int preset;
-    int rowWidth;
-    int pixelHeight;
+    ws2812_frames_t *frames;
+    volatile int preset;
+    const MATRIX *matrix;
     int ticksPerMS;
 
-    volatile int pixelWidth;
-    volatile int red;
-    volatile int green;
-    volatile int blue;
-    volatile int depth;
-    volatile int rate;
+    volatile int version;       // changes whenever a setting changes
+    volatile uint32_t color;
+    EFFECT_SETTINGS settings[EFFECT_COUNT];
+
+    volatile uint32_t frameCount;   // frames rendered
+    volatile uint32_t overrunCount; // frames that missed their deadline
+    volatile uint32_t pixelCount;   // pixels recomputed
+    volatile uint32_t skipCount;    // frames not sent because nothing changed
+    volatile uint32_t renderTicks;  // counter ticks spent rendering, wraps
+    volatile uint32_t renderCount;  // frames timed in renderTicks, unlike frameCount never reset
 
     int pixelWidthSetting;
     int levelSetting;
@@ -80,16 +125,42 @@ typedef struct {
     int blueSetting;
     int depthSetting;
     int rateSetting;
+
+    int widthSetting;
+    int heightSetting;
+    int wiringSetting;
+    int ledTypeSetting;
 } FLAME_STATE;
 
 FLAME_STATE flameState;
 
-long stack[32 + EXTRA_STACK_LONGS];
+long stack[64 + EXTRA_STACK_LONGS];
+long persistStack[160 + EXTRA_STACK_LONGS];
+long renderStacks[RENDER_COGS > 1 ? RENDER_COGS - 1 : 1][64 + EXTRA_STACK_LONGS];
+
+RENDER_POOL renderPool;
+FIRE_KERNEL fireKernel;
+
+// what the render cogs are working on this frame
+typedef struct {
+    const EFFECT *effect;
+    EFFECT_CONTEXT *ctx;
+    uint32_t *buf;
+} RENDER_JOB;
 
-FdSerial_t lcd;
+io_t io;
+FdSerial_t lcdSerial;
+LCD_STATE lcd;
 
 ws2812_t ledState;
-uint32_t ledValues[RGB_LED_COUNT];
+ws2812_frames_t ledFrames;
+uint32_t ledArena[(LED_ARENA_LEDS * LED_BYTES + 3) / 4];
+uint32_t *ledValues[2];
+uint16_t *ledMap;
+MATRIX ledMatrix;
+int ledType;
+uint8_t *effectScratch;
+int effectScratchSize;
 
 typedef struct {
     const char *label;
@@ -106,17 +177,65 @@ ADJUSTER adjusters[] = {
 {   "R",        "%02d", &flameState.redSetting,         0,  99,     0,  5   },
 {   "G",        "%02d", &flameState.greenSetting,       0,  99,     0,  9   },
 {   "B",        "%02d", &flameState.blueSetting,        0,  99,     0,  13  },
-{   "#",        "%01d", &flameState.preset,             1,  1,      1,  1   },
+{   "#",        "%01d", &flameState.preset,             1,  EFFECT_COUNT, 1, 1  },
 {   "P",        "%02d", &flameState.pixelWidthSetting,  1,  10,     1,  5   },
 {   "D",        "%02d", &flameState.depthSetting,       0,  99,     1,  9   },
 {   "S",        "%02d", &flameState.rateSetting,        0,  99,     1,  13  },
 {   NULL,       NULL,   NULL,                           0,  0,      0,  0   },
 };
 
-#define EEPROM_BASE     0x8000
+ADJUSTER setupAdjusters[] = {
+{   "W",        "%03d", &flameState.widthSetting,       1,  999,    0,  1   },
+{   "H",        "%02d", &flameState.heightSetting,      1,  99,     0,  6   },
+{   "M",        "%01d", &flameState.wiringSetting,      0,  7,      1,  1   },
+{   "T",        "%01d", &flameState.ledTypeSetting,     0,  LED_TYPE_COUNT - 1, 1, 4 },
+{   NULL,       NULL,   NULL,                           0,  0,      0,  0   },
+};
+
+#define GEOMETRY_STATUS_ROW 0
+#define GEOMETRY_STATUS_COL 9
+
+#define EEPROM_BASE     0x8000  // where settings were kept before the journal
+
+// settings journal from just past the old settings to the end of a 64K EEPROM
+#define STORE_BASE      (EEPROM_BASE + 0x400)
+#define STORE_SLOT_SIZE 64
+#define STORE_SLOTS     ((0x10000 - STORE_BASE) / STORE_SLOT_SIZE)
 #define EEPROM_MAGIC    "FIRE"
-#define EEPROM_VERSION  2
+#define EEPROM_VERSION  4
 
+// the small settings are kept in bytes so the record fits in a journal slot
+typedef struct {
+    char magic[4];
+    int version;
+    uint8_t levelSetting;
+    uint8_t redSetting;
+    uint8_t greenSetting;
+    uint8_t blueSetting;
+    uint8_t preset;
+    uint8_t ledType;        // LED_TYPE_xxx
+    uint8_t ledWiring;      // MATRIX_xxx
+    uint8_t ledHeight;      // number of rows
+    uint16_t ledWidth;      // pixels per row
+    EFFECT_SETTINGS presets[EFFECT_COUNT];
+} EEPROM_DATA;
+
+// fails to compile if the settings outgrow a journal slot
+typedef char EEPROM_DATA_FITS[sizeof(EEPROM_DATA) <= STORE_SLOT_SIZE - sizeof(STORE_HEADER) ? 1 : -1];
+
+// layout used before the strip geometry was a setting
+typedef struct {
+    char magic[4];
+    int version;
+    int levelSetting;
+    int redSetting;
+    int greenSetting;
+    int blueSetting;
+    int preset;
+    EFFECT_SETTINGS presets[EFFECT_COUNT];
+} EEPROM_DATA_V3;
+
+// layout used before each preset had its own settings
 typedef struct {
     char magic[4];
     int version;
@@ -127,90 +246,217 @@ typedef struct {
     int blueSetting;
     int depthSetting;
     int rateSetting;
-} EEPROM_DATA;
+} EEPROM_DATA_V2;
 
 EEPROM_DATA eepromData;
+STORE settingsStore;
+PERSIST settingsPersist;
 
 static void do_flame(void *params);
+static int renderSegment(void *arg, int segment);
 
 static void updateSettings(void);
 static void loadSettings(void);
 static void saveSettings(void);
 
+static int geometryFits(int width, int height);
+static void carveLedArena(int count);
+
+static int geometryFits(int width, int height)
+{
+    return width * height * LED_BYTES <= sizeof(ledArena);
+}
+
+// point the LED buffers at the arena, the frame buffers first to keep
+// them long aligned, the caller has checked that count LEDs fit
+static void carveLedArena(int count)
+{
+    uint8_t *p = (uint8_t *)ledArena;
+
+    ledValues[0] = (uint32_t *)p;
+    p += count * sizeof(uint32_t);
+    ledValues[1] = (uint32_t *)p;
+    p += count * sizeof(uint32_t);
+    ledMap = (uint16_t *)p;
+    p += count * sizeof(uint16_t);
+    effectScratch = p;
+    effectScratchSize = count * 3;
+}
+
+static void selectPreset(int preset);
 static void selectAdjuster(ADJUSTER *adjuster);
+static void showPage(ADJUSTER *page);
 static void displayAdjusterValue(ADJUSTER *adjuster);
+static void displayGeometryStatus(void);
+
+static int renderSegment(void *arg, int segment)
+{
+    RENDER_JOB *job = arg;
+    return job->effect->render(job->ctx, job->buf, segment);
+}
 
-static void lcdMoveCursor(int row, int col);
-static void lcdPutStr(int row, int col, const char *buf);
+static int lcdWrite(void *port, const char *buf, int len);
 
 int main(void)
 {
-    uint32_t buttonMask = 1 << BUTTON_PIN;
+    struct encoder_event event;
+    ADJUSTER *page = adjusters;
     ADJUSTER *adjuster;
+    int width, height, wiring;
     int ret;
-
-    ret = FdSerial_start(&lcd, LCD_RX_PIN, LCD_TX_PIN, 0, LCD_BAUD_RATE);
-    FdSerial_tx(&lcd, LCD_CLEAR);
-    FdSerial_tx(&lcd, LCD_CURSOR_OFF_BLINK);
-    FdSerial_tx(&lcd, LCD_BACKLIGHT_ON);
-    printf("FdSerial_start returned %d\n", ret);
+#if REPORT_MS
+    uint32_t reportTime, reportFrames = 0, reportTicks = 0;
+#endif
 
     printf("Initializing encoder...\n");
     encoder.m.pin = ENCODER_A_PIN;
     encoder.m.minValue = 0;
     encoder.m.maxValue = 255;
+    encoder.m.buttonPin = BUTTON_PIN;
+    encoder.m.longPressTicks = LONG_PRESS_MS * (CLKFREQ / 1000);
+    encoder.m.debounceTicks = ENCODER_DEBOUNCE_US * (CLKFREQ / 1000000);
+    encoder.m.accelTicks = ENCODER_ACCEL_MS * (CLKFREQ / 1000);
+#if USE_IO_COG
+    ret = io_start(&io, &lcdSerial, LCD_RX_PIN, LCD_TX_PIN, 0, LCD_BAUD_RATE, &encoder.m);
+    printf("io_start returned %d\n", ret);
+#else
+    ret = FdSerial_start(&lcdSerial, LCD_RX_PIN, LCD_TX_PIN, 0, LCD_BAUD_RATE);
+    printf("FdSerial_start returned %d\n", ret);
     ret = cognew(LOAD_START(encoder_fw), &encoder.m);
     printf("cognew returned %d\n", ret);
+#endif
 
-    printf("Initializing LED strip...\n");
-    ret = ws2812b_init(&ledState);
-    printf("ws2812b_init returned %d\n", ret);
+    FdSerial_tx(&lcdSerial, LCD_CLEAR);
+    FdSerial_tx(&lcdSerial, LCD_CURSOR_OFF_BLINK);
+    FdSerial_tx(&lcdSerial, LCD_BACKLIGHT_ON);
+    lcd_init(&lcd, lcdWrite, &lcdSerial);
 
     eeprom_init();
-        
-    flameState.buf = ledValues;
-    flameState.preset = 1;
-    flameState.rowWidth = RGB_ROW_WIDTH;
-    flameState.pixelHeight = RGB_PIXEL_HEIGHT;
-    flameState.ticksPerMS = CLKFREQ / 1000;
+    store_init(&settingsStore, STORE_BASE, STORE_SLOT_SIZE, STORE_SLOTS);
     loadSettings();
+
+    // run the default geometry if the saved one doesn't fit and open the
+    // setup page so it can be fixed
+    width = flameState.widthSetting;
+    height = flameState.heightSetting;
+    wiring = flameState.wiringSetting;
+    ledType = flameState.ledTypeSetting;
+    if (!geometryFits(width, height)) {
+        printf("Error: %dx%d LEDs don't fit in the %d LED arena\n", width, height, LED_ARENA_LEDS);
+        width = RGB_ROW_WIDTH;
+        height = RGB_PIXEL_HEIGHT;
+        wiring = RGB_WIRING;
+        page = setupAdjusters;
+    }
+    carveLedArena(width * height);
+
+    printf("Initializing %dx%d LED matrix...\n", width, height);
+    if (ledType == LED_TYPE_SK6812) {
+        ret = sk6812_init(&ledState);
+        printf("sk6812_init returned %d\n", ret);
+    }
+    else {
+        ret = ws2812b_init(&ledState);
+        printf("ws2812b_init returned %d\n", ret);
+    }
+
+    ws2812_frames_init(&ledFrames, &ledState, RGB_LED_PIN, ledValues[0], ledValues[1], width * height);
+    matrix_init(&ledMatrix, ledMap, width, height, wiring);
+
+    flameState.frames = &ledFrames;
+    flameState.matrix = &ledMatrix;
+    flameState.ticksPerMS = CLKFREQ / 1000;
     updateSettings();
 
+    ret = persist_start(&settingsPersist, &settingsStore, sizeof(EEPROM_DATA),
+                        SAVE_IDLE_MS * (CLKFREQ / 1000), SAVE_MAX_MS * (CLKFREQ / 1000),
+                        persistStack, sizeof(persistStack));
+    printf("persist_start returned %d\n", ret);
+
+#if USE_FIRE_COG
+    ret = fire_kernel_start(&fireKernel, LOAD_START(fire_fw), CNT);
+    printf("fire_kernel_start returned %d\n", ret);
+#endif
+
+    ret = render_start(&renderPool, RENDER_COGS - 1, renderStacks, sizeof(renderStacks[0]));
+    printf("render_start returned %d\n", ret);
+
+    // the workers leave a cog for this one, see RENDER_COGS
     ret = cogstart(do_flame, &flameState, stack, sizeof(stack));
     printf("cogstart returned %d\n", ret);
+    if (ret < 0)
+        printf("Error: no cog left to render the LEDs\n");
 
     printf("Entering idle loop...\n");
-    int lastButtonValue = 0;
-    int lastValue = 0;
+    int lastValue;
     
-    for (adjuster = adjusters; adjuster->label; ++adjuster)
-        displayAdjusterValue(adjuster);
-    adjuster = adjusters;
+    showPage(page);
+    adjuster = page;
     selectAdjuster(adjuster);
+    lastValue = encoder.m.value;
+#if REPORT_MS
+    reportTime = CNT;
+#endif
 
     for (;;) {
 
-        if (INA & buttonMask) {
-            if (!lastButtonValue) {
-                lastButtonValue = 1;
+        while (encoder_get_event(&encoder.m, &event)) {
+            switch (event.type) {
+            case ENCODER_EVENT_STEP:
+                // the encoder cog has already clamped or wrapped the value
+                if (encoder.m.value != lastValue) {
+                    lastValue = encoder.m.value;
+                    if (adjuster->pValue == &flameState.preset)
+                        selectPreset(lastValue);
+                    else {
+                        *adjuster->pValue = lastValue;
+                        displayAdjusterValue(adjuster);
+                        if (page == setupAdjusters)
+                            displayGeometryStatus();
+                    }
+                    lcd_move_cursor(&lcd, adjuster->valueRow, adjuster->valueCol - 1);
+                    updateSettings();
+                    saveSettings();
+                }
+                break;
+            case ENCODER_EVENT_PRESS:
                 saveSettings();
                 ++adjuster;
                 if (!adjuster->label)
-                    adjuster = adjusters;
+                    adjuster = page;
                 selectAdjuster(adjuster);
+                lastValue = encoder.m.value;
+                break;
+            case ENCODER_EVENT_LONG_PRESS:
+                // save now and switch between the main and setup pages
+                saveSettings();
+                persist_flush(&settingsPersist);
+                page = (page == adjusters ? setupAdjusters : adjusters);
+                showPage(page);
+                adjuster = page;
+                selectAdjuster(adjuster);
+                lastValue = encoder.m.value;
+                break;
             }
         }
-        else {
-            lastButtonValue = 0;
-        }
 
-        if (encoder.m.value != lastValue) {
-            lastValue = encoder.m.value;
-            *adjuster->pValue = lastValue;
-            displayAdjusterValue(adjuster);
-            lcdMoveCursor(adjuster->valueRow, adjuster->valueCol - 1);
-            updateSettings();
+        // send whatever changed as the serial queue has room
+        lcd_flush(&lcd);
+
+#if REPORT_MS
+        // compare builds with make USE_FIRE_COG=0 or USE_IO_COG=0, which
+        // change RENDER_COGS too
+        if ((int32_t)(CNT - reportTime) >= 0) {
+            uint32_t frames = flameState.renderCount;
+            uint32_t ticks = flameState.renderTicks;
+            if (frames != reportFrames)
+                printf("%u frames, %u overruns, %u cycles per frame\n",
+                       frames, flameState.overrunCount, (ticks - reportTicks) / (frames - reportFrames));
+            reportFrames = frames;
+            reportTicks = ticks;
+            reportTime += REPORT_MS * (CLKFREQ / 1000);
         }
+#endif
     }
 
     return 0;
@@ -218,70 +464,167 @@ int main(void)
 
 static void updateSettings(void)
 {
-    flameState.pixelWidth = flameState.pixelWidthSetting;
-    flameState.red = (flameState.levelSetting * flameState.redSetting * 255) / (99 * 99);
-    flameState.green = (flameState.levelSetting * flameState.greenSetting * 255) / (99 * 99);
-    flameState.blue = (flameState.levelSetting * flameState.blueSetting * 255) / (99 * 99);
-    flameState.depth = (flameState.depthSetting * 255) / 99;
-    flameState.rate = ((99 - flameState.rateSetting) * 990) / 99;
+    EFFECT_SETTINGS *settings = &flameState.settings[flameState.preset - 1];
+    int red = (flameState.levelSetting * flameState.redSetting * 255) / (99 * 99);
+    int green = (flameState.levelSetting * flameState.greenSetting * 255) / (99 * 99);
+    int blue = (flameState.levelSetting * flameState.blueSetting * 255) / (99 * 99);
+    settings->pixelWidth = flameState.pixelWidthSetting;
+    settings->depth = flameState.depthSetting;
+    settings->rate = flameState.rateSetting;
+    flameState.color = COLOR(red, green, blue);
+    ++flameState.version;
 }
 
 static void loadSettings(void)
 {
-    int ret = eeprom_read(EEPROM_BASE, (uint8_t *)&eepromData, sizeof(EEPROM_DATA));
-    if (ret != 0 || strncmp(eepromData.magic, EEPROM_MAGIC, sizeof(eepromData.magic)) != 0 || eepromData.version != EEPROM_VERSION) {
+    union {
+        EEPROM_DATA current;
+        EEPROM_DATA_V3 v3;
+        EEPROM_DATA_V2 v2;
+    } data;
+    int i;
+
+    // fall back to the fixed location used before the journal
+    int ret = store_load(&settingsStore, &data, sizeof(data));
+    if (ret < 0)
+        ret = eeprom_read(EEPROM_BASE, (uint8_t *)&data, sizeof(data));
+
+    // each version is checked against the size of its own layout
+    int valid = (ret >= (int)offsetof(EEPROM_DATA, levelSetting) && strncmp(data.current.magic, EEPROM_MAGIC, sizeof(data.current.magic)) == 0);
+    if (valid && data.current.version == EEPROM_VERSION && ret >= (int)sizeof(EEPROM_DATA)
+    &&  data.current.preset >= 1 && data.current.preset <= EFFECT_COUNT
+    &&  data.current.ledWidth >= 1 && data.current.ledHeight >= 1
+    &&  data.current.ledWiring <= (MATRIX_START_TOP | MATRIX_COLUMN_SERPENTINE)
+    &&  data.current.ledType < LED_TYPE_COUNT)
+        eepromData = data.current;
+    else {
         strncpy(eepromData.magic, EEPROM_MAGIC, sizeof(eepromData.magic));
         eepromData.version = EEPROM_VERSION;
-        eepromData.pixelWidthSetting = 2;
         eepromData.levelSetting = 50;
         eepromData.redSetting = 88; // 226
         eepromData.greenSetting = 47; // 121
         eepromData.blueSetting = 14; // 35
-        eepromData.depthSetting = 21; // 55
-        eepromData.rateSetting = 99;
+        eepromData.preset = 1;
+        eepromData.ledType = RGB_LED_TYPE;
+        eepromData.ledWiring = RGB_WIRING;
+        eepromData.ledHeight = RGB_PIXEL_HEIGHT;
+        eepromData.ledWidth = RGB_ROW_WIDTH;
+        for (i = 0; i < EFFECT_COUNT; ++i)
+            eepromData.presets[i] = effects[i].defaults;
+
+        // carry version 3 settings over with the default geometry
+        if (valid && data.v3.version == 3 && ret >= (int)sizeof(EEPROM_DATA_V3)
+        &&  data.v3.preset >= 1 && data.v3.preset <= EFFECT_COUNT) {
+            eepromData.levelSetting = data.v3.levelSetting;
+            eepromData.redSetting = data.v3.redSetting;
+            eepromData.greenSetting = data.v3.greenSetting;
+            eepromData.blueSetting = data.v3.blueSetting;
+            eepromData.preset = data.v3.preset;
+            for (i = 0; i < EFFECT_COUNT; ++i)
+                eepromData.presets[i] = data.v3.presets[i];
+        }
+
+        // carry version 2 settings over to the first preset
+        else if (valid && data.v2.version == 2 && ret >= (int)sizeof(EEPROM_DATA_V2)) {
+            eepromData.levelSetting = data.v2.levelSetting;
+            eepromData.redSetting = data.v2.redSetting;
+            eepromData.greenSetting = data.v2.greenSetting;
+            eepromData.blueSetting = data.v2.blueSetting;
+            eepromData.presets[0].pixelWidth = data.v2.pixelWidthSetting;
+            eepromData.presets[0].depth = data.v2.depthSetting;
+            eepromData.presets[0].rate = data.v2.rateSetting;
+        }
     }
-    flameState.pixelWidthSetting = eepromData.pixelWidthSetting;
     flameState.levelSetting = eepromData.levelSetting;
     flameState.redSetting = eepromData.redSetting;
     flameState.greenSetting = eepromData.greenSetting;
     flameState.blueSetting = eepromData.blueSetting;
-    flameState.depthSetting = eepromData.depthSetting;
-    flameState.rateSetting = eepromData.rateSetting;
+    for (i = 0; i < EFFECT_COUNT; ++i)
+        flameState.settings[i] = eepromData.presets[i];
+    flameState.preset = eepromData.preset;
+    flameState.pixelWidthSetting = flameState.settings[flameState.preset - 1].pixelWidth;
+    flameState.depthSetting = flameState.settings[flameState.preset - 1].depth;
+    flameState.rateSetting = flameState.settings[flameState.preset - 1].rate;
+    flameState.widthSetting = eepromData.ledWidth;
+    flameState.heightSetting = eepromData.ledHeight;
+    flameState.wiringSetting = eepromData.ledWiring;
+    flameState.ledTypeSetting = eepromData.ledType;
 }
 
+// hand the settings to the persist cog which writes them when things settle
 static void saveSettings(void)
 {
-    if (flameState.pixelWidthSetting != eepromData.pixelWidthSetting
-    ||  flameState.levelSetting != eepromData.levelSetting
-    ||  flameState.redSetting != eepromData.redSetting
-    ||  flameState.greenSetting != eepromData.greenSetting
-    ||  flameState.blueSetting != eepromData.blueSetting
-    ||  flameState.depthSetting != eepromData.depthSetting
-    ||  flameState.rateSetting != eepromData.rateSetting) {
-        EEPROM_DATA newData = eepromData;
-        newData.pixelWidthSetting = flameState.pixelWidthSetting;
-        newData.levelSetting = flameState.levelSetting;
-        newData.redSetting = flameState.redSetting;
-        newData.greenSetting = flameState.greenSetting;
-        newData.blueSetting = flameState.blueSetting;
-        newData.depthSetting = flameState.depthSetting;
-        newData.rateSetting = flameState.rateSetting;
-        if (eeprom_write(EEPROM_BASE, (uint8_t *)&newData, sizeof(EEPROM_DATA)) == 0)
-            eepromData = newData;
+    EEPROM_DATA newData = eepromData;
+    int i;
+    newData.levelSetting = flameState.levelSetting;
+    newData.redSetting = flameState.redSetting;
+    newData.greenSetting = flameState.greenSetting;
+    newData.blueSetting = flameState.blueSetting;
+    newData.preset = flameState.preset;
+    newData.ledType = flameState.ledTypeSetting;
+    newData.ledWiring = flameState.wiringSetting;
+    newData.ledHeight = flameState.heightSetting;
+    newData.ledWidth = flameState.widthSetting;
+    for (i = 0; i < EFFECT_COUNT; ++i)
+        newData.presets[i] = flameState.settings[i];
+    if (memcmp(&newData, &eepromData, sizeof(EEPROM_DATA)) != 0) {
+        persist_update(&settingsPersist, &newData);
+        eepromData = newData;
     }
 }
 
+static void selectPreset(int preset)
+{
+    EFFECT_SETTINGS *settings = &flameState.settings[preset - 1];
+    ADJUSTER *adjuster;
+
+    // the settings of the old preset were saved by updateSettings
+    flameState.pixelWidthSetting = settings->pixelWidth;
+    flameState.depthSetting = settings->depth;
+    flameState.rateSetting = settings->rate;
+    flameState.preset = preset;
+
+    for (adjuster = adjusters; adjuster->label; ++adjuster)
+        displayAdjusterValue(adjuster);
+}
+
+static void showPage(ADJUSTER *page)
+{
+    ADJUSTER *adjuster;
+
+    lcd_put_str(&lcd, 0, 0, "                ");
+    lcd_put_str(&lcd, 1, 0, "                ");
+    for (adjuster = page; adjuster->label; ++adjuster)
+        displayAdjusterValue(adjuster);
+    if (page == setupAdjusters)
+        displayGeometryStatus();
+}
+
+// geometry changes take effect at the next reset
+static void displayGeometryStatus(void)
+{
+    const char *status = "       ";
+    if (!geometryFits(flameState.widthSetting, flameState.heightSetting))
+        status = "TOO BIG";
+    else if (flameState.widthSetting != ledMatrix.width
+         ||  flameState.heightSetting != ledMatrix.height
+         ||  flameState.wiringSetting != ledMatrix.wiring
+         ||  flameState.ledTypeSetting != ledType)
+        status = "RESTART";
+    lcd_put_str(&lcd, GEOMETRY_STATUS_ROW, GEOMETRY_STATUS_COL, status);
+}
+
 static void displayAdjusterValue(ADJUSTER *adjuster)
 {
     char buf[10];
-    lcdPutStr(adjuster->valueRow, adjuster->valueCol - 1, adjuster->label);
+    lcd_put_str(&lcd, adjuster->valueRow, adjuster->valueCol - 1, adjuster->label);
     sprintf(buf, adjuster->format, *adjuster->pValue);
-    lcdPutStr(adjuster->valueRow, adjuster->valueCol, buf);
+    lcd_put_str(&lcd, adjuster->valueRow, adjuster->valueCol, buf);
 }
 
 static void selectAdjuster(ADJUSTER *adjuster)
 {
-    lcdMoveCursor(adjuster->valueRow, adjuster->valueCol - 1);
+    lcd_move_cursor(&lcd, adjuster->valueRow, adjuster->valueCol - 1);
     encoder.m.value = *adjuster->pValue;
     encoder.m.minValue = adjuster->minValue;
     encoder.m.maxValue = adjuster->maxValue;
@@ -291,42 +634,67 @@ static void selectAdjuster(ADJUSTER *adjuster)
 static void do_flame(void *params)
 {
     FLAME_STATE *state = params;
+    const EFFECT *effect = NULL;
+    EFFECT_CONTEXT ctx;
+    RENDER_JOB job;
+    FRAME_SCHED sched;
+    int preset = 0;
+    int version = 0;
+    uint32_t start;
+    int i;
+
+    ctx.matrix = state->matrix;
+    ctx.type = ledState.type;
+    ctx.buffers = 2;
+    ctx.scratch = effectScratch;
+    ctx.scratchSize = effectScratchSize;
+    ctx.segments = renderPool.segments;
+    for (i = 0; i < ctx.segments; ++i)
+        fastrand_seed(&ctx.rng[i], CNT + i * 0x9e3779b9);
+    job.ctx = &ctx;
+
     for (;;) {
-        int x, px, py;
-        int i = 0;
-        for (x = 0; x < state->rowWidth; x += state->pixelWidth) {
-            int flicker = rand() % state->depth;
-            int red = state->red - flicker;
-            int green = state->green - flicker;
-            int blue = state->blue - flicker;
-            if (red < 0) red = 0;
-            if (green < 0) green = 0;
-            if (blue < 0) blue = 0;
-            int color = (red << 16) | (green << 8) | blue;
-            int j = i;
-            for (py = 0; py < state->pixelHeight; ++py) {
-                for (px = 0; px < state->pixelWidth; ++px) {
-                    if (j + px < state->rowWidth)
-                        state->buf[j + px] = color;
-                }
-                j += state->rowWidth;
-            }
-            i += state->pixelWidth;
+        uint32_t *buf = ws2812_frames_back(state->frames);
+        int written;
+
+        // switching presets takes effect on the next frame
+        if (state->preset != preset) {
+            preset = state->preset;
+            effect = effect_get(preset);
+            effect->init(&ctx);
+            version = state->version - 1;
+            sched_start(&sched, CNT, effect->frameMs * state->ticksPerMS);
+        }
+        if (state->version != version) {
+            version = state->version;
+            ctx.color = state->color;
+            effect->params(&ctx, &state->settings[preset - 1]);
         }
-        ws2812_update(&ledState, RGB_LED_PIN, state->buf, RGB_LED_COUNT);
-        waitcnt(CNT + (10 + rand() % state->rate) * state->ticksPerMS);
-    }
-}
 
-static void lcdMoveCursor(int row, int col)
-{
-    FdSerial_tx(&lcd, LCD_MOVE_CURSOR + row * 20 + col);
+        // the frame goes to the driver only after every segment is done
+        job.effect = effect;
+        job.buf = buf;
+        start = CNT;
+        written = render_frame(&renderPool, renderSegment, &job);
+        state->renderTicks += CNT - start;
+        ++state->renderCount;
+
+        // leave the strip latched when nothing changed
+        if (written) {
+            ws2812_frames_present(state->frames);
+            state->pixelCount += written;
+        }
+        else
+            ++state->skipCount;
+
+        waitcnt(sched_next(&sched, CNT));
+        state->frameCount = sched.frames;
+        state->overrunCount = sched.overruns;
+    }
 }
 
-static void lcdPutStr(int row, int col, const char *buf)
+static int lcdWrite(void *port, const char *buf, int len)
 {
-    lcdMoveCursor(row, col);
-    while (*buf)
-        FdSerial_tx(&lcd, *buf++);
+    return FdSerial_try_write(port, buf, len);
 }
 
@@ -0,0 +1,75 @@
+/**
+ * @file flicker.c
+ *
+ * @brief Flicker engine that randomly dims groups of pixels.
+ */
+
+#include <string.h>
+#include "flicker.h"
+#include "pixel.h"
+#include "ws2812.h"
+
+// start every group over and redraw it in every buffer
+static void flicker_reset(FLICKER_STATE *flicker)
+{
+    memset(flicker->timers, 0, flicker->width);
+    memset(flicker->pending, flicker->buffers, flicker->width);
+}
+
+void flicker_init(FLICKER_STATE *flicker, uint8_t *scratch, const MATRIX *matrix, int buffers)
+{
+    int width = matrix->width;
+    flicker->matrix = matrix;
+    flicker->width = width;
+    flicker->buffers = buffers;
+    flicker->timers = scratch;
+    flicker->amounts = scratch + width;
+    flicker->pending = scratch + 2 * width;
+    flicker->pixelWidth = 1;
+    memset(flicker->amounts, 0, width);
+    flicker_reset(flicker);
+}
+
+void flicker_params(FLICKER_STATE *flicker, uint32_t color, int pixelWidth, int depth, int rate)
+{
+    if (pixelWidth != flicker->pixelWidth || color != flicker->color)
+        flicker_reset(flicker);
+    flicker->color = color;
+    flicker->pixelWidth = pixelWidth;
+    flicker->groups = (flicker->width + pixelWidth - 1) / pixelWidth;
+    flicker->depth = depth;
+    flicker->rate = rate;
+}
+
+int flicker_render(FLICKER_STATE *flicker, uint32_t *buf, int type, fastrand_t *rng, int first, int last)
+{
+    const MATRIX *matrix = flicker->matrix;
+    int written = 0;
+    int x, y, g;
+    for (g = first, x = first * flicker->pixelWidth; g < last; ++g, x += flicker->pixelWidth) {
+        if (flicker->timers[g] == 0) {
+            int amount = fastrand_range(rng, flicker->depth);
+            if (amount != flicker->amounts[g]) {
+                flicker->amounts[g] = amount;
+                flicker->pending[g] = flicker->buffers;
+            }
+            flicker->timers[g] = fastrand_range(rng, flicker->rate);
+        }
+        else
+            --flicker->timers[g];
+
+        if (flicker->pending[g] == 0)
+            continue;
+        --flicker->pending[g];
+
+        uint32_t color = ws2812_pixel(type, pixel_sub(flicker->color, pixel_splat(flicker->amounts[g])));
+        written += matrix_fill_span(matrix, buf, 0, x, x + flicker->pixelWidth, color);
+    }
+
+    // every row shows the same colors as the bottom one
+    if (written) {
+        for (y = 1; y < matrix->height; ++y)
+            matrix_copy_span(matrix, buf, y, 0, first * flicker->pixelWidth, last * flicker->pixelWidth);
+    }
+    return written * matrix->height;
+}
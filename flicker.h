@@ -0,0 +1,64 @@
+/**
+ * @file flicker.h
+ *
+ * @brief Flicker engine that randomly dims groups of pixels.
+ *
+ * Every group has its own timer, so groups change at random times while
+ * frames are rendered at a fixed rate. Only groups that changed are written
+ * to the frame buffers, once to each buffer in rotation.
+ */
+
+#ifndef __FLICKER_H__
+#define __FLICKER_H__
+
+#include <stdint.h>
+#include "fastrand.h"
+#include "matrix.h"
+
+typedef struct {
+    uint32_t color;     // base color in $RRGGBB form
+    int pixelWidth;     // pixels in each group
+    int depth;          // most a group is dimmed (0 to 255)
+    int rate;           // most frames a group keeps its flicker (0 to 255)
+    const MATRIX *matrix;
+    int width;          // pixels per row
+    int groups;         // groups in a row
+    int buffers;        // frame buffers in rotation
+    uint8_t *timers;    // frames until each group changes
+    uint8_t *amounts;   // current flicker of each group
+    uint8_t *pending;   // buffers each group still has to be written to
+} FLICKER_STATE;
+
+/**
+ * Initializes the engine.
+ *
+ * flicker - Engine state.
+ * scratch - Working memory, at least 3 * width bytes.
+ * matrix - Layout of the LEDs.
+ * buffers - Number of frame buffers in rotation.
+ */
+void flicker_init(FLICKER_STATE *flicker, uint8_t *scratch, const MATRIX *matrix, int buffers);
+
+/**
+ * Sets the base color, group width, flicker depth and rate.
+ */
+void flicker_params(FLICKER_STATE *flicker, uint32_t color, int pixelWidth, int depth, int rate);
+
+/**
+ * Renders groups first up to but not including last of one frame. Groups
+ * whose timer has run out get a new random amount of flicker. Every row
+ * gets the same colors. Cogs can render separate ranges of groups at the
+ * same time.
+ *
+ * flicker - Engine state.
+ * buf - Frame buffer, width * height pixels in wire order.
+ * type - Color format of the chain (TYPE_xxx).
+ * rng - Random number state of the calling cog.
+ * first - First group to render.
+ * last - Group after the last one to render, at most flicker->groups.
+ *
+ * Returns the number of pixels written, 0 if buf already holds them.
+ */
+int flicker_render(FLICKER_STATE *flicker, uint32_t *buf, int type, fastrand_t *rng, int first, int last);
+
+#endif
@@ -0,0 +1,30 @@
+/**
+ * @file io.c
+ *
+ * @brief One cog for the LCD serial port, the encoder and the button.
+ */
+
+#include <propeller.h>
+#include "io.h"
+
+int io_start(io_t *io, FdSerial_t *serial, int rxpin, int txpin, int mode, int baudrate, volatile struct encoder_mailbox *encoder)
+{
+    extern uint32_t binary_io_driver_dat_start[];
+
+    FdSerial_init(serial, rxpin, txpin, mode, baudrate);
+    io->serial = serial;
+    io->encoder = encoder;
+    io->buttonDebounceTicks = ENCODER_BUTTON_DEBOUNCE_MS * (CLKFREQ / 1000);
+    io->cogId = cognew(binary_io_driver_dat_start, io);
+
+    // FdSerial_stop leaves the shared cog alone, use io_stop instead
+    return io->cogId;
+}
+
+void io_stop(io_t *io)
+{
+    if (io->cogId >= 0) {
+        cogstop(io->cogId);
+        io->cogId = -1;
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ * @file io.h
+ *
+ * @brief One cog for the LCD serial port, the encoder and the button.
+ *
+ * io_driver.spin runs the FdSerial receiver and transmitter and the
+ * encoder_fw decoder as jmpret tasks in a single cog. The FdSerial_t and
+ * encoder_mailbox interfaces are the same as with the separate drivers.
+ */
+
+#ifndef __IO_H__
+#define __IO_H__
+
+#include <stdint.h>
+#include "fds.h"
+#include "encoder.h"
+
+typedef struct {
+    FdSerial_t *serial;                     // read by the driver at startup
+    volatile struct encoder_mailbox *encoder;
+    uint32_t buttonDebounceTicks;
+    int cogId;
+} io_t;
+
+/**
+ * Starts one cog running the serial port and the encoder. The encoder
+ * mailbox settings must be filled in first.
+ * @param rxpin is pin number for receive input
+ * @param txpin is pin number for transmit output
+ * @param mode is interface mode. see header FDSERIAL_MODE_...
+ * @param baudrate is frequency of bits ... 115200, 57600, etc...
+ * @returns the cog number or -1 if no cog was available
+ */
+int io_start(io_t *io, FdSerial_t *serial, int rxpin, int txpin, int mode, int baudrate, volatile struct encoder_mailbox *encoder);
+
+/**
+ * Stops the I/O cog.
+ */
+void io_stop(io_t *io);
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * @file lcd.c
+ *
+ * @brief Shadow buffer for the 2x16 serial LCD.
+ */
+
+#include <string.h>
+#include "lcd.h"
+
+static int lcd_send(LCD_STATE *lcd, const char *buf, int len)
+{
+    int sent = (*lcd->write)(lcd->port, buf, len);
+    lcd->bytesSent += sent;
+    return sent;
+}
+
+static int lcd_send_cursor(LCD_STATE *lcd, int address)
+{
+    char cmd = LCD_MOVE_CURSOR + address;
+    if (lcd_send(lcd, &cmd, 1) != 1)
+        return 0;
+    lcd->panelCursor = address;
+    return 1;
+}
+
+void lcd_init(LCD_STATE *lcd, LCD_WRITE write, void *port)
+{
+    lcd->write = write;
+    lcd->port = port;
+    memset(lcd->shadow, ' ', sizeof(lcd->shadow));
+    memset(lcd->panel, ' ', sizeof(lcd->panel));
+    lcd->cursor = 0;
+    lcd->panelCursor = 0;   // clearing the panel homes the cursor
+    lcd->bytesSent = 0;
+}
+
+void lcd_put_str(LCD_STATE *lcd, int row, int col, const char *str)
+{
+    if (row < 0 || row >= LCD_ROWS)
+        return;
+    while (*str && col < LCD_COLS) {
+        if (col >= 0)
+            lcd->shadow[row][col] = *str;
+        ++str;
+        ++col;
+    }
+}
+
+void lcd_move_cursor(LCD_STATE *lcd, int row, int col)
+{
+    lcd->cursor = row * LCD_ROW_STRIDE + col;
+}
+
+int lcd_flush(LCD_STATE *lcd)
+{
+    int row, col, end, sent;
+
+    for (row = 0; row < LCD_ROWS; ++row) {
+        const char *shadow = lcd->shadow[row];
+        char *panel = lcd->panel[row];
+        for (col = 0; col < LCD_COLS; col = end) {
+            if (shadow[col] == panel[col]) {
+                end = col + 1;
+                continue;
+            }
+
+            // one cursor move covers a whole run of changed characters
+            for (end = col + 1; end < LCD_COLS && shadow[end] != panel[end]; ++end)
+                ;
+            if (lcd->panelCursor != row * LCD_ROW_STRIDE + col
+            &&  !lcd_send_cursor(lcd, row * LCD_ROW_STRIDE + col))
+                return 0;
+
+            sent = lcd_send(lcd, &shadow[col], end - col);
+            memcpy(&panel[col], &shadow[col], sent);
+            lcd->panelCursor += sent;
+            if (col + sent < end)
+                return 0;
+
+            // where the panel puts the cursor after the last column varies
+            if (end == LCD_COLS)
+                lcd->panelCursor = -1;
+        }
+    }
+
+    if (lcd->panelCursor != lcd->cursor && !lcd_send_cursor(lcd, lcd->cursor))
+        return 0;
+    return 1;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file lcd.h
+ *
+ * @brief Shadow buffer for the 2x16 serial LCD.
+ *
+ * Text is drawn into a shadow copy of the screen and lcd_flush sends only
+ * the characters that differ from what the panel shows, with one cursor
+ * move per run of changed characters. Output goes through a non-blocking
+ * write function so the same code can drive a fake panel on a host.
+ */
+
+#ifndef __LCD_H__
+#define __LCD_H__
+
+#include <stdint.h>
+
+#define LCD_ROWS        2
+#define LCD_COLS        16
+#define LCD_ROW_STRIDE  20  // cursor address distance between rows
+
+enum {
+    LCD_CLEAR               = 0x0c,
+    LCD_BACKLIGHT_ON        = 0x11,
+    LCD_BACKLIGHT_OFF       = 0x12,
+    LCD_CURSOR_OFF_NO_BLINK = 0x16,
+    LCD_CURSOR_OFF_BLINK    = 0x17,
+    LCD_MOVE_CURSOR         = 0x80
+};
+
+// queues up to len bytes without blocking and returns how many were taken
+typedef int (*LCD_WRITE)(void *port, const char *buf, int len);
+
+typedef struct {
+    LCD_WRITE write;
+    void *port;
+    char shadow[LCD_ROWS][LCD_COLS];    // what the screen should show
+    char panel[LCD_ROWS][LCD_COLS];     // what the panel shows
+    int cursor;         // cursor address wanted after the flush
+    int panelCursor;    // cursor address on the panel, -1 if unknown
+    uint32_t bytesSent;
+} LCD_STATE;
+
+/**
+ * Starts tracking a panel that has just been cleared.
+ */
+void lcd_init(LCD_STATE *lcd, LCD_WRITE write, void *port);
+
+/**
+ * Draws a string into the shadow buffer. Text past the end of the row is
+ * dropped.
+ */
+void lcd_put_str(LCD_STATE *lcd, int row, int col, const char *str);
+
+/**
+ * Sets where the cursor should be left after the next flush.
+ */
+void lcd_move_cursor(LCD_STATE *lcd, int row, int col);
+
+/**
+ * Sends as much of the difference between the shadow buffer and the panel
+ * as the output will take.
+ * @returns 1 if the panel is up to date, 0 if more remains to be sent.
+ */
+int lcd_flush(LCD_STATE *lcd);
+
+#endif
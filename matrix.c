@@ -0,0 +1,86 @@
+/**
+ * @file matrix.c
+ *
+ * @brief Maps x, y coordinates on an LED matrix to positions on the strip.
+ */
+
+#include <string.h>
+#include "matrix.h"
+
+void matrix_init(MATRIX *matrix, uint16_t *map, int width, int height, int wiring)
+{
+    int x, y, row, i;
+
+    matrix->width = width;
+    matrix->height = height;
+    matrix->wiring = wiring;
+    matrix->map = map;
+
+    for (y = 0; y < height; ++y) {
+        row = (wiring & MATRIX_START_TOP) ? height - 1 - y : y;
+        for (x = 0; x < width; ++x) {
+            switch (wiring & ~MATRIX_START_TOP) {
+            case MATRIX_SERPENTINE:
+                i = row * width + ((row & 1) ? width - 1 - x : x);
+                break;
+            case MATRIX_COLUMNS:
+                i = x * height + row;
+                break;
+            case MATRIX_COLUMN_SERPENTINE:
+                i = x * height + ((x & 1) ? height - 1 - row : row);
+                break;
+            default:
+                i = row * width + x;
+                break;
+            }
+            map[y * width + x] = i;
+        }
+    }
+}
+
+int matrix_fill_span(const MATRIX *matrix, uint32_t *buf, int y, int x0, int x1, uint32_t color)
+{
+    const uint16_t *p, *end;
+
+    if (x0 < 0)
+        x0 = 0;
+    if (x1 > matrix->width)
+        x1 = matrix->width;
+    if (x0 >= x1)
+        return 0;
+
+    p = matrix->map + y * matrix->width;
+    end = p + x1;
+    for (p += x0; p < end; ++p)
+        buf[*p] = color;
+    return x1 - x0;
+}
+
+void matrix_copy_span(const MATRIX *matrix, uint32_t *buf, int dst, int src, int x0, int x1)
+{
+    const uint16_t *d, *s;
+    int count, span, x;
+
+    if (x0 < 0)
+        x0 = 0;
+    if (x1 > matrix->width)
+        x1 = matrix->width;
+    if (x0 >= x1)
+        return;
+
+    d = matrix->map + dst * matrix->width;
+    s = matrix->map + src * matrix->width;
+    count = x1 - x0;
+    span = d[x1 - 1] - d[x0];
+
+    // rows laid along the strip in the same direction are one block copy
+    if (span == s[x1 - 1] - s[x0] && (span == count - 1 || span == 1 - count)) {
+        if (span < 0)
+            memcpy(buf + d[x1 - 1], buf + s[x1 - 1], count * sizeof(uint32_t));
+        else
+            memcpy(buf + d[x0], buf + s[x0], count * sizeof(uint32_t));
+        return;
+    }
+    for (x = x0; x < x1; ++x)
+        buf[d[x]] = buf[s[x]];
+}
@@ -0,0 +1,73 @@
+/**
+ * @file matrix.h
+ *
+ * @brief Maps x, y coordinates on an LED matrix to positions on the strip.
+ *
+ * The mapping is worked out once into a table so effects can be written in
+ * matrix coordinates, with row 0 at the bottom, whatever way the strip is
+ * wired. A single strip is a matrix one row high.
+ */
+
+#ifndef __MATRIX_H__
+#define __MATRIX_H__
+
+#include <stdint.h>
+
+// how the strip runs through the matrix
+#define MATRIX_ROWS             0   // along each row, every row left to right
+#define MATRIX_SERPENTINE       1   // along each row, alternating direction
+#define MATRIX_COLUMNS          2   // up each column, every column bottom to top
+#define MATRIX_COLUMN_SERPENTINE 3  // up and down the columns
+
+// or'ed with the wiring when the strip starts at the top of the matrix
+#define MATRIX_START_TOP        4
+
+typedef struct {
+    int width;          // pixels per row
+    int height;         // number of rows
+    int wiring;         // MATRIX_xxx
+    uint16_t *map;      // strip position of each pixel, one row after another
+} MATRIX;
+
+/**
+ * Builds the coordinate table.
+ *
+ * matrix - Matrix description.
+ * map - Table of width * height entries.
+ * width - Pixels per row.
+ * height - Number of rows.
+ * wiring - How the strip runs through the matrix (MATRIX_xxx).
+ */
+void matrix_init(MATRIX *matrix, uint16_t *map, int width, int height, int wiring);
+
+/**
+ * Returns the strip position of a pixel.
+ */
+static inline int matrix_index(const MATRIX *matrix, int x, int y)
+{
+    return matrix->map[y * matrix->width + x];
+}
+
+/**
+ * Sets the pixels from x0 up to but not including x1 on row y, clipped to
+ * the row.
+ *
+ * Returns the number of pixels written.
+ */
+int matrix_fill_span(const MATRIX *matrix, uint32_t *buf, int y, int x0, int x1, uint32_t color);
+
+/**
+ * Copies the pixels from x0 up to but not including x1 of row src to the
+ * same columns of row dst, clipped to the row.
+ */
+void matrix_copy_span(const MATRIX *matrix, uint32_t *buf, int dst, int src, int x0, int x1);
+
+/**
+ * Copies row src to row dst.
+ */
+static inline void matrix_copy_row(const MATRIX *matrix, uint32_t *buf, int dst, int src)
+{
+    matrix_copy_span(matrix, buf, dst, src, 0, matrix->width);
+}
+
+#endif
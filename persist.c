@@ -0,0 +1,98 @@
+/**
+ * @file persist.c
+ *
+ * @brief Saves settings from a helper cog so the UI never waits on EEPROM.
+ */
+
+#include <string.h>
+#include <propeller.h>
+#include "persist.h"
+
+static void do_persist(void *params);
+
+int persist_start(PERSIST *persist, STORE *store, int size, uint32_t idleTicks, uint32_t maxTicks, void *stack, int stackSize)
+{
+    persist->store = store;
+    persist->size = size;
+    persist->idleTicks = idleTicks;
+    persist->maxTicks = maxTicks;
+    persist->seq = 0;
+    persist->saved = 0;
+    persist->flush = 0;
+    persist->error = 0;
+    persist->writes = 0;
+    persist->cogId = cogstart(do_persist, persist, stack, stackSize);
+    return persist->cogId;
+}
+
+void persist_update(PERSIST *persist, const void *data)
+{
+    ++persist->seq;
+    memcpy(persist->data, data, persist->size);
+    ++persist->seq;
+}
+
+void persist_flush(PERSIST *persist)
+{
+    persist->flush = 1;
+}
+
+int persist_pending(PERSIST *persist)
+{
+    return persist->saved != persist->seq;
+}
+
+// copy the snapshot, retrying if the UI updated it at the same time
+static uint32_t persist_snapshot(PERSIST *persist, uint8_t *buf)
+{
+    uint32_t seq;
+    do {
+        while ((seq = persist->seq) & 1)
+            ;
+        memcpy(buf, persist->data, persist->size);
+    } while (persist->seq != seq);
+    return seq;
+}
+
+static void do_persist(void *params)
+{
+    PERSIST *persist = params;
+    uint8_t buf[STORE_SLOT_MAX];
+    uint32_t pollTicks = PERSIST_POLL_MS * (CLKFREQ / 1000);
+    uint32_t seen = persist->seq;
+    uint32_t changeTime = CNT;
+    uint32_t firstTime = changeTime;
+    uint32_t now, seq;
+    int32_t ret;
+
+    for (;;) {
+        waitcnt(CNT + pollTicks);
+        now = CNT;
+
+        // note when changes start and when they were last made
+        if ((seq = persist->seq) != seen) {
+            if (seen == persist->saved)
+                firstTime = now;
+            seen = seq;
+            changeTime = now;
+        }
+
+        if (seen == persist->saved)
+            persist->flush = 0;
+        else if (persist->flush || now - changeTime >= persist->idleTicks || now - firstTime >= persist->maxTicks) {
+            persist->flush = 0;
+            seq = persist_snapshot(persist, buf);
+            ret = store_save(persist->store, buf, persist->size);
+            if (ret == persist->size) {
+                persist->saved = seq;
+                persist->error = 0;
+                ++persist->writes;
+            }
+            else {
+                // try again after another idle period
+                persist->error = ret;
+                changeTime = firstTime = now;
+            }
+        }
+    }
+}
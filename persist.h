@@ -0,0 +1,58 @@
+/**
+ * @file persist.h
+ *
+ * @brief Saves settings from a helper cog so the UI never waits on EEPROM.
+ *
+ * The UI publishes a snapshot of its settings whenever they change. The
+ * helper cog writes the newest snapshot to the settings store once the
+ * settings have been left alone for a while, or after a bounded delay if
+ * they keep changing, so a burst of changes costs one write. The snapshot
+ * is guarded by a sequence count that is odd while it is being updated.
+ */
+
+#ifndef __PERSIST_H__
+#define __PERSIST_H__
+
+#include <stdint.h>
+#include "store.h"
+
+// how often the helper cog checks for changes
+#define PERSIST_POLL_MS     10
+
+typedef struct {
+    STORE *store;
+    int size;
+    uint32_t idleTicks;         // save after no changes for this long
+    uint32_t maxTicks;          // or this long after the first unsaved change
+    volatile uint32_t seq;      // odd while the snapshot is being updated
+    volatile uint32_t saved;    // seq of the last snapshot written
+    volatile int flush;         // save now without waiting
+    volatile int32_t error;     // result of the last failed save, 0 if none
+    volatile uint32_t writes;   // records written
+    uint8_t data[STORE_SLOT_MAX];
+    int cogId;
+} PERSIST;
+
+/**
+ * Starts the helper cog. Snapshots are size bytes.
+ * @returns the cog number or -1 if no cog was available
+ */
+int persist_start(PERSIST *persist, STORE *store, int size, uint32_t idleTicks, uint32_t maxTicks, void *stack, int stackSize);
+
+/**
+ * Publishes a new snapshot. Only one cog may call this.
+ */
+void persist_update(PERSIST *persist, const void *data);
+
+/**
+ * Asks for the newest snapshot to be saved without waiting for the idle
+ * time. Doesn't wait for the write.
+ */
+void persist_flush(PERSIST *persist);
+
+/**
+ * @returns nonzero while a published snapshot hasn't been saved.
+ */
+int persist_pending(PERSIST *persist);
+
+#endif
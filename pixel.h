@@ -0,0 +1,69 @@
+/**
+ * @file pixel.h
+ *
+ * @brief Branch-free helpers for $RRGGBB pixel longs.
+ *
+ * Each helper works on all three channels at once. Red and blue are handled
+ * together as two 16 bit lanes, green on its own, so every channel has room
+ * for a carry or borrow. The top byte of the inputs is ignored and the top
+ * byte of the results is zero.
+ */
+
+#ifndef __PIXEL_H__
+#define __PIXEL_H__
+
+#include <stdint.h>
+
+#define PIXEL_RB    0x00FF00FF
+#define PIXEL_G     0x0000FF00
+
+// the same value in all three channels
+static inline uint32_t pixel_splat(uint32_t v)
+{
+    v &= 0xff;
+    return (v << 16) | (v << 8) | v;
+}
+
+// a - b in each channel, stopping at 0
+static inline uint32_t pixel_sub(uint32_t a, uint32_t b)
+{
+    uint32_t rb = ((a & PIXEL_RB) | 0x01000100) - (b & PIXEL_RB);
+    uint32_t g = ((a & PIXEL_G) | 0x00010000) - (b & PIXEL_G);
+    uint32_t mrb = rb & 0x01000100;     // guard bit survives if there was no borrow
+    uint32_t mg = g & 0x00010000;
+    mrb -= mrb >> 8;
+    mg -= mg >> 8;
+    return (rb & mrb) | (g & mg);
+}
+
+// a + b in each channel, stopping at 255
+static inline uint32_t pixel_add(uint32_t a, uint32_t b)
+{
+    uint32_t rb = (a & PIXEL_RB) + (b & PIXEL_RB);
+    uint32_t g = (a & PIXEL_G) + (b & PIXEL_G);
+    uint32_t mrb = rb & 0x01000100;     // guard bit is set on a carry
+    uint32_t mg = g & 0x00010000;
+    mrb -= mrb >> 8;
+    mg -= mg >> 8;
+    return ((rb | mrb) & PIXEL_RB) | ((g | mg) & PIXEL_G);
+}
+
+// each channel times level / 255 (the same as SCALE in ws2812.h)
+static inline uint32_t pixel_scale(uint32_t c, uint32_t level)
+{
+    uint32_t rb = (c & PIXEL_RB) * level;
+    uint32_t g = ((c >> 8) & 0xff) * level;
+    // x / 255 == (x + 1 + (x >> 8)) >> 8 for x <= 255 * 255
+    rb = ((rb + 0x00010001 + ((rb >> 8) & PIXEL_RB)) >> 8) & PIXEL_RB;
+    g = (g + 1 + (g >> 8)) & 0xff00;
+    return rb | g;
+}
+
+// a faded towards b, t = 0 gives a and t = 255 gives b
+static inline uint32_t pixel_blend(uint32_t a, uint32_t b, uint32_t t)
+{
+    // the two scaled parts never add up to more than 255
+    return pixel_scale(a, 255 - t) + pixel_scale(b, t);
+}
+
+#endif
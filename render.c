@@ -0,0 +1,71 @@
+/**
+ * @file render.c
+ *
+ * @brief Splits rendering each frame between worker cogs.
+ */
+
+#include <string.h>
+#include <propeller.h>
+#include "render.h"
+
+static void render_worker(void *par)
+{
+    RENDER_WORKER *worker = par;
+    RENDER_POOL *pool = worker->pool;
+    uint32_t frame = 0;
+
+    for (;;) {
+
+        // wait for the render cog to start the next frame
+        while (pool->frame == frame)
+            ;
+        frame = pool->frame;
+
+        pool->written[worker->segment] = pool->func(pool->arg, worker->segment);
+        pool->done[worker->segment] = frame;
+    }
+}
+
+int render_start(RENDER_POOL *pool, int workers, void *stacks, int stackSize)
+{
+    uint8_t *stack = stacks;
+    int i;
+
+    memset(pool, 0, sizeof(RENDER_POOL));
+    pool->segments = 1;
+
+    if (workers > RENDER_MAX_SEGMENTS - 1)
+        workers = RENDER_MAX_SEGMENTS - 1;
+
+    for (i = 0; i < workers; ++i, stack += stackSize) {
+        RENDER_WORKER *worker = &pool->workers[pool->segments];
+        worker->pool = pool;
+        worker->segment = pool->segments;
+        if (cogstart(render_worker, worker, stack, stackSize) < 0)
+            break;
+        ++pool->segments;
+    }
+
+    return pool->segments;
+}
+
+int render_frame(RENDER_POOL *pool, RENDER_FUNC func, void *arg)
+{
+    uint32_t frame = pool->frame + 1;
+    int written, i;
+
+    // the workers only look at func and arg once the frame number changes
+    pool->func = func;
+    pool->arg = arg;
+    pool->frame = frame;
+
+    written = func(arg, 0);
+
+    for (i = 1; i < pool->segments; ++i) {
+        while (pool->done[i] != frame)
+            ;
+        written += pool->written[i];
+    }
+
+    return written;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file render.h
+ *
+ * @brief Splits rendering each frame between worker cogs.
+ *
+ * The render cog renders segment 0 of a frame and each worker cog renders
+ * one of the others. The cogs meet at a barrier built from hub longs that
+ * each have a single writer: the render cog bumps the frame number to
+ * release the workers and each worker copies it to its own done flag when
+ * its segment is finished, so no locks are needed.
+ */
+
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include <stdint.h>
+
+// most segments in a frame, the render cog included
+#define RENDER_MAX_SEGMENTS 8
+
+// renders one segment of a frame, returns the number of pixels written
+typedef int (*RENDER_FUNC)(void *arg, int segment);
+
+struct RENDER_POOL;
+
+typedef struct {
+    struct RENDER_POOL *pool;
+    int segment;
+} RENDER_WORKER;
+
+typedef struct RENDER_POOL {
+    volatile uint32_t frame;            // bumped to start each frame
+    RENDER_FUNC volatile func;
+    void *volatile arg;
+    int segments;                       // worker cogs running plus one
+    volatile uint32_t done[RENDER_MAX_SEGMENTS];    // last frame each segment finished
+    volatile int written[RENDER_MAX_SEGMENTS];      // pixels written by each segment
+    RENDER_WORKER workers[RENDER_MAX_SEGMENTS];
+} RENDER_POOL;
+
+/**
+ * Starts up to workers worker cogs, each with stackSize bytes of stack
+ * taken in turn from stacks. Rendering carries on with fewer segments if
+ * there aren't enough free cogs.
+ *
+ * Returns the number of segments in each frame.
+ */
+int render_start(RENDER_POOL *pool, int workers, void *stacks, int stackSize);
+
+/**
+ * Renders one frame by calling func for every segment at the same time,
+ * segment 0 on the calling cog, and waits until all of them are done.
+ *
+ * Returns the total number of pixels written.
+ */
+int render_frame(RENDER_POOL *pool, RENDER_FUNC func, void *arg);
+
+#endif
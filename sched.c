@@ -0,0 +1,31 @@
+/**
+ * @file sched.c
+ *
+ * @brief Frame scheduler with an absolute timebase.
+ */
+
+#include "sched.h"
+
+void sched_start(FRAME_SCHED *sched, uint32_t now, uint32_t period)
+{
+    sched->period = period;
+    sched->deadline = now + period;
+    sched->frames = 0;
+    sched->overruns = 0;
+    sched->dropped = 0;
+}
+
+uint32_t sched_next(FRAME_SCHED *sched, uint32_t now)
+{
+    uint32_t deadline = sched->deadline;
+    ++sched->frames;
+    if ((int32_t)(deadline - now) < SCHED_MARGIN) {
+        ++sched->overruns;
+        do {
+            deadline += sched->period;
+            ++sched->dropped;
+        } while ((int32_t)(deadline - now) < SCHED_MARGIN);
+    }
+    sched->deadline = deadline + sched->period;
+    return deadline;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file sched.h
+ *
+ * @brief Frame scheduler with an absolute timebase.
+ *
+ * Frame deadlines are kept as system counter values and advance by exactly
+ * one period per frame, so the frame rate doesn't drift with render or
+ * transmit time. Nothing here reads CNT so the logic can be driven by a
+ * simulated clock.
+ */
+
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#include <stdint.h>
+
+// deadlines closer than this are treated as missed so waitcnt can't wrap
+#define SCHED_MARGIN    1000
+
+typedef struct {
+    uint32_t period;    // ticks per frame
+    uint32_t deadline;  // counter value at which the current frame ends
+    uint32_t frames;    // frames completed
+    uint32_t overruns;  // frames that finished after their deadline
+    uint32_t dropped;   // whole periods skipped to catch up
+} FRAME_SCHED;
+
+/**
+ * Starts a new timebase with the first frame ending one period from now.
+ */
+void sched_start(FRAME_SCHED *sched, uint32_t now, uint32_t period);
+
+/**
+ * Ends the current frame and returns the counter value to wait for before
+ * starting the next one. A late frame is counted as an overrun and the
+ * deadline skips ahead by whole periods to stay on the timebase.
+ */
+uint32_t sched_next(FRAME_SCHED *sched, uint32_t now);
+
+#endif
@@ -0,0 +1,138 @@
+/**
+ * @file store.c
+ *
+ * @brief Journaled settings store in upper EEPROM.
+ */
+
+#include <string.h>
+#include <stddef.h>
+#include "store.h"
+
+#define STORE_ERASED    0xffffffff
+
+static const uint16_t crcNibbles[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+};
+
+uint16_t store_crc(uint16_t crc, const uint8_t *data, int size)
+{
+    while (--size >= 0) {
+        crc = (crc << 4) ^ crcNibbles[(crc >> 12) ^ (*data >> 4)];
+        crc = (crc << 4) ^ crcNibbles[(crc >> 12) ^ (*data++ & 0x0f)];
+    }
+    return crc;
+}
+
+static uint16_t record_crc(const uint8_t *record)
+{
+    const STORE_HEADER *header = (const STORE_HEADER *)record;
+    uint16_t crc = store_crc(0xffff, record, offsetof(STORE_HEADER, crc));
+    return store_crc(crc, record + sizeof(STORE_HEADER), header->size);
+}
+
+static uint32_t slot_address(STORE *store, int slot)
+{
+    return store->base + slot * store->slotSize;
+}
+
+static uint32_t slot_seq(STORE *store, int slot)
+{
+    uint32_t seq;
+    if (eeprom_read(slot_address(store, slot), (uint8_t *)&seq, sizeof(seq)) != sizeof(seq))
+        return STORE_ERASED;
+    return seq;
+}
+
+// read a record into buf, returns its data size or -1 if it isn't valid
+static int slot_read(STORE *store, int slot, uint8_t *buf)
+{
+    STORE_HEADER *header = (STORE_HEADER *)buf;
+    uint32_t addr = slot_address(store, slot);
+
+    if (eeprom_read(addr, buf, sizeof(STORE_HEADER)) != sizeof(STORE_HEADER)
+    ||  header->seq == STORE_ERASED
+    ||  header->size > store->slotSize - sizeof(STORE_HEADER))
+        return -1;
+    if (eeprom_read(addr + sizeof(STORE_HEADER), buf + sizeof(STORE_HEADER), header->size) != header->size
+    ||  record_crc(buf) != header->crc)
+        return -1;
+    return header->size;
+}
+
+void store_init(STORE *store, uint32_t base, int slotSize, int slots)
+{
+    store->base = base;
+    store->slotSize = slotSize;
+    store->slots = slots;
+    store->next = 0;
+    store->seq = 0;
+}
+
+int store_load(STORE *store, void *data, int size)
+{
+    uint8_t buf[STORE_SLOT_MAX];
+    STORE_HEADER *header = (STORE_HEADER *)buf;
+    uint32_t first = slot_seq(store, 0);
+    int lo, hi, mid, slot, tries, ret;
+
+    store->next = 0;
+    store->seq = 0;
+
+    // slots written on the current pass around the ring hold first,
+    // first + 1, ... so binary search for the last one that fits
+    if (first != STORE_ERASED) {
+        lo = 0;
+        hi = store->slots - 1;
+        while (lo < hi) {
+            mid = (lo + hi + 1) >> 1;
+            if (slot_seq(store, mid) == first + mid)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        slot = lo;
+    }
+
+    // an erased first slot means nothing was written or the first write
+    // of a new pass was cut off before it started
+    else if (slot_seq(store, store->slots - 1) != STORE_ERASED)
+        slot = store->slots - 1;
+    else
+        return STORE_ERR_EMPTY;
+
+    // a torn record can only be the newest one so step back past it
+    for (tries = 0; (ret = slot_read(store, slot, buf)) < 0; ) {
+        if (++tries >= store->slots)
+            return STORE_ERR_EMPTY;
+        slot = (slot > 0 ? slot : store->slots) - 1;
+    }
+
+    store->next = slot + 1 < store->slots ? slot + 1 : 0;
+    store->seq = header->seq;
+    memcpy(data, buf + sizeof(STORE_HEADER), ret < size ? ret : size);
+    return ret;
+}
+
+int store_save(STORE *store, const void *data, int size)
+{
+    uint8_t buf[STORE_SLOT_MAX];
+    STORE_HEADER *header = (STORE_HEADER *)buf;
+    int ret;
+
+    if (size > store->slotSize - (int)sizeof(STORE_HEADER))
+        return STORE_ERR_SIZE;
+
+    header->seq = store->seq + 1;
+    header->size = size;
+    memcpy(buf + sizeof(STORE_HEADER), data, size);
+    header->crc = record_crc(buf);
+
+    ret = eeprom_write(slot_address(store, store->next), buf, sizeof(STORE_HEADER) + size);
+    if (ret < 0)
+        return ret;
+
+    store->seq = header->seq;
+    store->next = store->next + 1 < store->slots ? store->next + 1 : 0;
+    return size;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file store.h
+ *
+ * @brief Journaled settings store in upper EEPROM.
+ *
+ * Each save appends a record to the next slot of a ring instead of
+ * rewriting one location, which spreads the wear over the whole ring. A
+ * record carries a sequence number and a CRC so a record torn by a power
+ * cut is skipped and the one before it is used. Slots never cross an
+ * EEPROM page so each record is written in a single page write.
+ */
+
+#ifndef __STORE_H__
+#define __STORE_H__
+
+#include <stdint.h>
+#include "eeprom.h"
+
+// largest slot, header included
+#define STORE_SLOT_MAX      EEPROM_PAGE_SIZE
+
+// returned by store_load when there is no valid record
+#define STORE_ERR_EMPTY     -10
+// returned by store_save when the data doesn't fit in a slot
+#define STORE_ERR_SIZE      -11
+
+typedef struct {
+    uint32_t seq;       // sequence number, 0xffffffff in an erased slot
+    uint16_t size;      // bytes of data following the header
+    uint16_t crc;       // CRC-16 of the header and data
+} STORE_HEADER;
+
+typedef struct {
+    uint32_t base;      // EEPROM address of the first slot
+    int slotSize;       // bytes per slot, a divisor of EEPROM_PAGE_SIZE
+    int slots;          // number of slots in the ring
+    int next;           // slot the next record goes in
+    uint32_t seq;       // sequence number of the newest record, 0 if none
+} STORE;
+
+/**
+ * Describes the ring. Call store_load to find the newest record before
+ * saving.
+ */
+void store_init(STORE *store, uint32_t base, int slotSize, int slots);
+
+/**
+ * Finds the newest valid record and copies up to size bytes of it.
+ * @returns the size of the record or a negative error code.
+ */
+int store_load(STORE *store, void *data, int size);
+
+/**
+ * Appends a record after the newest one.
+ * @returns size or a negative error code.
+ */
+int store_save(STORE *store, const void *data, int size);
+
+/**
+ * CRC-16/CCITT of a block of bytes.
+ */
+uint16_t store_crc(uint16_t crc, const uint8_t *data, int size);
+
+#endif
@@ -0,0 +1,8 @@
+/**
+ * @file cog.h
+ *
+ * @brief Host stand-in for PropGCC's cog.h, the tested sources only need
+ * propeller.h.
+ */
+
+#include <propeller.h>
@@ -0,0 +1,478 @@
+/**
+ * @file eeprom_test.c
+ *
+ * @brief Runs eeprom.c against a simulated pair of 24LC512s on the pins.
+ *
+ * There is no I2C driver cog on the host so eeprom.c uses its bit-banged
+ * fallback. The test is built with HOST_PINS: every OUTA, DIRA or INA
+ * access goes through host_pin, which follows SCL and SDA and steps the
+ * device model on each START, STOP and clock edge. The devices sit at A0
+ * = 0 and 1 so addresses 0x10000 and up select the second one.
+ *
+ * The simulated CNT advances one 400kHz SCL period on each rising edge of
+ * SCL, so times are what the driver cog would take on the bus. A write
+ * cycle starts on the STOP after a write with data and keeps the device
+ * from acknowledging its control byte for writeTicks.
+ */
+
+#include <propeller.h>
+#include <string.h>
+#include "eeprom.h"
+#include "test.h"
+
+#define SCL_MASK        (1 << I2C_SCL)
+#define SDA_MASK        (1 << I2C_SDA)
+#define SCL_TICKS       (CLKFREQ / 400000)
+#define MS(n)           ((uint32_t)(n) * (CLKFREQ / 1000))
+#define BANKS           2
+#define MAX_WRITES      64
+
+// what the device does on the next clock
+enum { IDLE, RECEIVE, ACK, SEND, MASTER_ACK };
+
+typedef struct {
+    uint8_t mem[BANKS][0x10000];
+    uint8_t latch[EEPROM_PAGE_SIZE];    // page being written
+    uint8_t latched[EEPROM_PAGE_SIZE];
+    uint32_t writeTicks;                // write cycle time
+    uint32_t busyUntil;
+    int busy;
+    int nakAt;                          // byte of each transaction to NAK, -1 for none
+
+    int state, bits, byteNo, bank, reading, pull;
+    uint8_t shift;
+    uint32_t addr;
+    int dataCount;
+
+    // bus counts
+    uint32_t clocks;
+    int starts, stops;
+    int polls;                          // control bytes NAKed while busy
+    int writes;                         // write cycles started
+    int writeCounts[MAX_WRITES];        // data bytes of each write cycle
+    uint32_t selectTime;                // CNT when the device last acked a write control byte
+    int errors;                         // protocol errors seen by the model
+} DEVICE;
+
+static DEVICE dev;
+static uint32_t simCnt;
+static uint32_t outa, dira, ina;
+static int lastScl = 1, lastSda = 1;
+
+uint32_t binary_i2c_driver_dat_start[1];
+
+uint32_t host_cnt(void)
+{
+    return simCnt;
+}
+
+static int device_busy(void)
+{
+    if (dev.busy && (int32_t)(simCnt - dev.busyUntil) >= 0)
+        dev.busy = 0;
+    return dev.busy;
+}
+
+static void device_start(void)
+{
+    ++dev.starts;
+    dev.state = RECEIVE;
+    dev.bits = 0;
+    dev.shift = 0;
+    dev.byteNo = 0;
+    dev.dataCount = 0;
+    dev.pull = 0;
+    memset(dev.latched, 0, sizeof(dev.latched));
+}
+
+// a write cycle only starts when data bytes were sent
+static void device_stop(void)
+{
+    int i;
+
+    ++dev.stops;
+    if (dev.state != IDLE && !dev.reading && dev.dataCount > 0) {
+        for (i = 0; i < EEPROM_PAGE_SIZE; ++i)
+            if (dev.latched[i])
+                dev.mem[dev.bank][(dev.addr & ~(EEPROM_PAGE_SIZE - 1)) | i] = dev.latch[i];
+        if (dev.writes < MAX_WRITES)
+            dev.writeCounts[dev.writes] = dev.dataCount;
+        ++dev.writes;
+        dev.busy = 1;
+        dev.busyUntil = simCnt + dev.writeTicks;
+    }
+    dev.state = IDLE;
+    dev.pull = 0;
+}
+
+static void device_byte(void)
+{
+    int ack = 1;
+
+    if (dev.byteNo == 0) {
+        if ((dev.shift & 0xF0) != 0xA0 || ((dev.shift >> 1) & 7) >= BANKS || device_busy()) {
+            if ((dev.shift & 0xF0) == 0xA0)
+                ++dev.polls;
+            dev.state = IDLE;
+            return;
+        }
+        dev.bank = (dev.shift >> 1) & 7;
+        dev.reading = dev.shift & I2C_READ;
+        if (!dev.reading)
+            dev.selectTime = simCnt;
+    }
+    else if (dev.reading)
+        ++dev.errors;
+    else if (dev.byteNo == 1)
+        dev.addr = (uint32_t)dev.shift << 8;
+    else if (dev.byteNo == 2)
+        dev.addr |= dev.shift;
+    else {
+        // the address counter wraps within the page while writing
+        int i = (dev.addr + dev.dataCount) & (EEPROM_PAGE_SIZE - 1);
+        dev.latch[i] = dev.shift;
+        dev.latched[i] = 1;
+        ++dev.dataCount;
+    }
+
+    if (dev.byteNo == dev.nakAt)
+        ack = 0;
+    ++dev.byteNo;
+    dev.pull = ack;
+    dev.state = ack ? ACK : IDLE;
+}
+
+static void device_send_bit(void)
+{
+    dev.pull = !(dev.mem[dev.bank][dev.addr] & (0x80 >> dev.bits));
+}
+
+static void device_rise(int sda)
+{
+    ++dev.clocks;
+    simCnt += SCL_TICKS;
+    if (dev.state == RECEIVE) {
+        dev.shift = (dev.shift << 1) | sda;
+        ++dev.bits;
+    }
+    else if (dev.state == SEND)
+        ++dev.bits;
+    else if (dev.state == MASTER_ACK)
+        dev.reading = sda ? -1 : 1;     // NAK ends the read
+}
+
+static void device_fall(void)
+{
+    switch (dev.state) {
+    case RECEIVE:
+        if (dev.bits == 8)
+            device_byte();
+        break;
+    case ACK:
+        dev.bits = 0;
+        dev.shift = 0;
+        dev.pull = 0;
+        if (dev.reading) {
+            dev.state = SEND;
+            device_send_bit();
+        }
+        else
+            dev.state = RECEIVE;
+        break;
+    case SEND:
+        if (dev.bits == 8) {
+            dev.pull = 0;
+            dev.state = MASTER_ACK;
+        }
+        else
+            device_send_bit();
+        break;
+    case MASTER_ACK:
+        dev.addr = (dev.addr + 1) & 0xFFFF;
+        if (dev.reading > 0) {
+            dev.bits = 0;
+            dev.state = SEND;
+            device_send_bit();
+        }
+        else {
+            dev.reading = 1;
+            dev.state = IDLE;
+        }
+        break;
+    }
+}
+
+// the change the code made since the last access, then the register
+volatile uint32_t *host_pin(int reg)
+{
+    int scl = !(dira & SCL_MASK) || (outa & SCL_MASK);
+    int sda = (!(dira & SDA_MASK) || (outa & SDA_MASK)) && !dev.pull;
+
+    if (scl && lastScl && sda != lastSda) {
+        // a read has to end with a NAK before the bus is released
+        if (dev.state == SEND)
+            ++dev.errors;
+        if (sda)
+            device_stop();
+        else
+            device_start();
+    }
+    else if (scl && !lastScl)
+        device_rise(sda);
+    else if (!scl && lastScl)
+        device_fall();
+
+    // the device may have let go of SDA or pulled it low
+    sda = (!(dira & SDA_MASK) || (outa & SDA_MASK)) && !dev.pull;
+    lastScl = scl;
+    lastSda = sda;
+
+    switch (reg) {
+    case HOST_OUTA:
+        return &outa;
+    case HOST_DIRA:
+        return &dira;
+    }
+    ina = (scl ? SCL_MASK : 0) | (sda ? SDA_MASK : 0);
+    return &ina;
+}
+
+static void reset(uint32_t writeTicks)
+{
+    int i;
+
+    memset(&dev, 0, sizeof(dev));
+    for (i = 0; i < 0x10000; ++i) {
+        dev.mem[0][i] = 0xFF;
+        dev.mem[1][i] = 0xFF;
+    }
+    dev.writeTicks = writeTicks;
+    dev.nakAt = -1;
+    simCnt = 0xfff00000;                // just before CNT wraps
+}
+
+static void fill(uint8_t *data, int count, int seed)
+{
+    int i;
+    for (i = 0; i < count; ++i)
+        data[i] = (uint8_t)(i * 7 + seed);
+}
+
+static void test_init(void)
+{
+    uint8_t data[4];
+
+    reset(MS(3));
+    eeprom_init();
+    CHECK_EQ(dev.errors, 0);
+    CHECK(ina & SDA_MASK);
+
+    // a read cut short leaves the device driving a zero bit on SDA
+    dev.mem[0][0] = 0;
+    dev.mem[0][1] = 0;
+    i2c_start();
+    i2c_write(0xA0 | I2C_READ);
+    i2c_read(I2C_ACK);
+    CHECK_EQ(dev.state, SEND);
+    CHECK_EQ(dev.pull, 1);
+
+    // init clocks it out
+    eeprom_init();
+    CHECK_EQ(dev.pull, 0);
+    CHECK(ina & SDA_MASK);
+    CHECK_EQ(eeprom_read(0, data, 2), 2);
+    CHECK_EQ(data[0], 0);
+    CHECK_EQ(data[1], 0);
+    CHECK_EQ(dev.errors, 0);
+}
+
+static void test_page_split(void)
+{
+    static uint8_t data[300], back[300];
+
+    reset(MS(3));
+    eeprom_init();
+    fill(data, sizeof(data), 1);
+    CHECK_EQ(eeprom_write(100, data, sizeof(data)), 300);
+
+    // each page in its own write cycle, nothing wrapped within a page
+    CHECK_EQ(dev.writes, 4);
+    CHECK_EQ(dev.writeCounts[0], EEPROM_PAGE_SIZE - 100 % EEPROM_PAGE_SIZE);
+    CHECK_EQ(dev.writeCounts[1], EEPROM_PAGE_SIZE);
+    CHECK_EQ(dev.writeCounts[2], EEPROM_PAGE_SIZE);
+    CHECK_EQ(dev.writeCounts[3], 300 - dev.writeCounts[0] - 2 * EEPROM_PAGE_SIZE);
+    CHECK(memcmp(&dev.mem[0][100], data, sizeof(data)) == 0);
+    CHECK_EQ(dev.mem[0][99], 0xFF);
+    CHECK_EQ(dev.mem[0][400], 0xFF);
+
+    CHECK_EQ(eeprom_read(100, back, sizeof(back)), 300);
+    CHECK(memcmp(back, data, sizeof(data)) == 0);
+
+    // a whole aligned page is one write cycle
+    dev.writes = 0;
+    CHECK_EQ(eeprom_write(2 * EEPROM_PAGE_SIZE, data, EEPROM_PAGE_SIZE), EEPROM_PAGE_SIZE);
+    CHECK_EQ(dev.writes, 1);
+
+    // a read is split at the 64K bank, a write at the page
+    fill(data, sizeof(data), 5);
+    dev.writes = 0;
+    CHECK_EQ(eeprom_write(0x10000 - 50, data, 100), 100);
+    CHECK_EQ(dev.writes, 2);
+    CHECK(memcmp(&dev.mem[0][0x10000 - 50], data, 50) == 0);
+    CHECK(memcmp(&dev.mem[1][0], data + 50, 50) == 0);
+    dev.starts = 0;
+    CHECK_EQ(eeprom_read(0x10000 - 50, back, 100), 100);
+    CHECK(memcmp(back, data, 100) == 0);
+    CHECK(dev.starts >= 4);                 // a START and a repeated START per bank
+    CHECK_EQ(dev.errors, 0);
+}
+
+static void test_ack_polling(void)
+{
+    uint8_t data[16], back[16];
+    uint32_t stopped, pollTicks;
+
+    reset(MS(3));
+    eeprom_init();
+    fill(data, sizeof(data), 9);
+    CHECK_EQ(eeprom_write(0, data, sizeof(data)), 16);
+    stopped = simCnt;
+    CHECK(device_busy());
+
+    // the read polls the device until its write cycle is over
+    dev.polls = 0;
+    CHECK_EQ(eeprom_read(0, back, sizeof(back)), 16);
+    CHECK(memcmp(back, data, sizeof(data)) == 0);
+    CHECK(dev.polls > 0);
+
+    // and is selected within a poll of the device becoming ready, 10 clocks
+    pollTicks = 20 * SCL_TICKS;
+    CHECK((int32_t)(dev.selectTime - (stopped + MS(3))) >= 0);
+    CHECK((int32_t)(dev.selectTime - (stopped + MS(3))) <= (int32_t)pollTicks);
+
+    // a write right after a write polls too
+    dev.polls = 0;
+    CHECK_EQ(eeprom_write(32, data, sizeof(data)), 16);
+    CHECK_EQ(eeprom_write(64, data, sizeof(data)), 16);
+    CHECK(dev.polls > 0);
+    CHECK(memcmp(&dev.mem[0][64], data, sizeof(data)) == 0);
+    CHECK_EQ(dev.errors, 0);
+}
+
+static void test_errors(void)
+{
+    uint8_t data[16];
+    uint32_t start;
+
+    reset(MS(3));
+    eeprom_init();
+    fill(data, sizeof(data), 3);
+
+    // a NAK on the address or on a data byte
+    dev.nakAt = 1;
+    CHECK_EQ(eeprom_write(0, data, sizeof(data)), EEPROM_ERR_NAK);
+    CHECK_EQ(eeprom_read(0, data, sizeof(data)), EEPROM_ERR_NAK);
+    dev.nakAt = 2;
+    CHECK_EQ(eeprom_read(0, data, sizeof(data)), EEPROM_ERR_NAK);
+    dev.nakAt = 5;
+    CHECK_EQ(eeprom_write(0, data, sizeof(data)), EEPROM_ERR_NAK);
+
+    // the transaction was ended with a STOP, the bus is free
+    CHECK_EQ(dev.state, IDLE);
+    CHECK(ina & SCL_MASK);
+    CHECK(ina & SDA_MASK);
+    dev.nakAt = -1;
+    CHECK_EQ(eeprom_write(0, data, sizeof(data)), 16);
+
+    // a device that never finishes its write cycle
+    dev.writeTicks = MS(1000);
+    CHECK_EQ(eeprom_write(16, data, sizeof(data)), 16);
+    start = simCnt;
+    CHECK_EQ(eeprom_read(0, data, sizeof(data)), EEPROM_ERR_BUSY);
+    CHECK(simCnt - start >= MS(EEPROM_BUSY_MS));
+    CHECK(simCnt - start < MS(EEPROM_BUSY_MS) + 10 * SCL_TICKS);
+
+    // no device at all looks the same
+    reset(MS(3));
+    eeprom_init();
+    dev.nakAt = 0;
+    start = simCnt;
+    CHECK_EQ(eeprom_write(0, data, sizeof(data)), EEPROM_ERR_BUSY);
+    CHECK(simCnt - start >= MS(EEPROM_BUSY_MS));
+    CHECK_EQ(dev.writes, 0);
+    CHECK_EQ(dev.errors, 0);
+}
+
+// the old eeprom_write: 64 byte pages and a fixed 5 ms wait after each
+static void fixed_wait_write(uint32_t addr, uint8_t *ptr, uint32_t count)
+{
+    uint32_t n, i;
+
+    while (count > 0) {
+        n = 64 - (addr & 63);
+        if (n > count)
+            n = count;
+        i2c_start();
+        i2c_write(0xA0 | I2C_WRITE);
+        i2c_write(addr >> 8);
+        i2c_write(addr & 0xFF);
+        for (i = 0; i < n; ++i)
+            i2c_write(ptr[i]);
+        i2c_stop();
+        simCnt += MS(5);
+        addr += n;
+        ptr += n;
+        count -= n;
+    }
+}
+
+// prints the time and bus clocks to save a block and read a byte back
+static void report(void)
+{
+    static const int writeUs[] = { 1500, 3000, 5000 };
+    static const int sizes[] = { 16, 256, 4096 };
+    static uint8_t data[4096];
+    uint8_t byte;
+    uint32_t start, polledTicks, polledClocks, fixedTicks, fixedClocks;
+    int i, j;
+
+    fill(data, sizeof(data), 0);
+    for (i = 0; i < (int)(sizeof(writeUs) / sizeof(writeUs[0])); ++i) {
+        for (j = 0; j < (int)(sizeof(sizes) / sizeof(sizes[0])); ++j) {
+            reset(writeUs[i] * (CLKFREQ / 1000000));
+            eeprom_init();
+            dev.clocks = 0;
+            start = simCnt;
+            eeprom_write(0, data, sizes[j]);
+            eeprom_read(0, &byte, 1);
+            polledTicks = simCnt - start;
+            polledClocks = dev.clocks;
+
+            reset(writeUs[i] * (CLKFREQ / 1000000));
+            eeprom_init();
+            dev.clocks = 0;
+            start = simCnt;
+            fixed_wait_write(0, data, sizes[j]);
+            eeprom_read(0, &byte, 1);
+            fixedTicks = simCnt - start;
+            fixedClocks = dev.clocks;
+
+            // a part that takes the full 5 ms still costs no more than a poll
+            CHECK(polledTicks < fixedTicks + 10 * SCL_TICKS);
+            CHECK(writeUs[i] >= 5000 || polledTicks < fixedTicks);
+            printf("eeprom_test: %4d us write cycle  %4d bytes  polled %7.2f ms %6u clocks  fixed wait %7.2f ms %6u clocks  %4.1fx\n",
+                   writeUs[i], sizes[j], polledTicks / (CLKFREQ / 1000.0), polledClocks,
+                   fixedTicks / (CLKFREQ / 1000.0), fixedClocks, (double)fixedTicks / polledTicks);
+        }
+    }
+}
+
+int main(void)
+{
+    test_init();
+    test_page_split();
+    test_ack_polling();
+    test_errors();
+    report();
+    return test_done("eeprom_test");
+}
@@ -0,0 +1,236 @@
+/**
+ * @file encoder_test.c
+ *
+ * @brief Replays synthetic quadrature traces through encoder_decode and
+ * reports the step error rate.
+ *
+ * A trace turns the knob a number of detent steps at a fixed rate, with
+ * contact bounce after each edge, and is sampled every SAMPLE_TICKS the
+ * way the encoder cog polls INA. Times start just before CNT wraps.
+ *
+ * The event ring is checked on its own: reads from an empty ring, a full
+ * ring dropping new events, and the head and tail wrapping.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "encoder.h"
+#include "test.h"
+
+#define CLOCK           80000000
+#define US(n)           ((n) * (CLOCK / 1000000))
+#define SAMPLE_TICKS    US(2)
+#define DEBOUNCE_TICKS  US(100)     // ENCODER_DEBOUNCE_US in flames.c
+#define ACCEL_TICKS     US(40000)   // ENCODER_ACCEL_MS in flames.c
+#define START_TIME      0xfff00000
+
+// input states in clockwise order
+static const unsigned int gray[4] = { 0, 1, 3, 2 };
+
+typedef struct {
+    int steps;          // steps the decoder reported
+    uint32_t missed;    // illegal transitions it saw
+} RESULT;
+
+/*
+ * turns the knob dir * count steps, one every period ticks, each edge
+ * bouncing for up to bounce ticks; with skew the states are held for
+ * period + skew and period - skew in turn, like an encoder with uneven
+ * phases
+ */
+static RESULT replay(int count, int dir, uint32_t period, uint32_t skew, uint32_t bounce, uint32_t accelTicks)
+{
+    struct encoder_decoder d;
+    RESULT result = { 0, 0 };
+    uint32_t t = START_TIME, end, settle;
+    unsigned int from, to;
+    int pos = 0, i;
+
+    encoder_decoder_init(&d, t, gray[0], DEBOUNCE_TICKS, accelTicks);
+    for (i = 0; i < count; ++i) {
+        from = gray[pos & 3];
+        pos += dir;
+        to = gray[pos & 3];
+        settle = t + (bounce ? (uint32_t)rand() % bounce : 0);
+        end = t + period + (i & 1 ? -skew : skew);
+        for (; (int32_t)(end - t) > 0; t += SAMPLE_TICKS) {
+            unsigned int sample = (int32_t)(settle - t) > 0 && (rand() & 1) ? from : to;
+            result.steps += encoder_decode(&d, t, sample);
+        }
+    }
+
+    // let the last state settle
+    for (end = t + 2 * DEBOUNCE_TICKS; (int32_t)(end - t) > 0; t += SAMPLE_TICKS)
+        result.steps += encoder_decode(&d, t, gray[pos & 3]);
+    result.missed = d.missed;
+    return result;
+}
+
+static void test_clean(void)
+{
+    RESULT r;
+
+    r = replay(400, 1, US(5000), 0, 0, 0);
+    CHECK_EQ(r.steps, 400);
+    CHECK_EQ(r.missed, 0);
+    r = replay(400, -1, US(1000), 0, 0, 0);
+    CHECK_EQ(r.steps, -400);
+    CHECK_EQ(r.missed, 0);
+}
+
+// bounce chatters faster than the debounce time, so it is never seen even
+// when it lasts longer than that
+static void test_bounce(void)
+{
+    RESULT r;
+
+    srand(1);
+    r = replay(400, 1, US(2000), 0, US(300), 0);
+    CHECK_EQ(r.steps, 400);
+    CHECK_EQ(r.missed, 0);
+    r = replay(400, -1, US(800), 0, US(250), 0);
+    CHECK_EQ(r.steps, -400);
+    CHECK_EQ(r.missed, 0);
+}
+
+// states too short to settle are counted as missed and made up for
+static void test_too_fast(void)
+{
+    RESULT r;
+
+    // every other state is missed except the last, which is left to settle
+    srand(2);
+    r = replay(400, 1, US(300), US(250), US(20), 0);
+    CHECK_EQ(r.missed, 199);
+    CHECK_EQ(r.steps, 400);
+    r = replay(400, -1, US(300), US(250), US(20), 0);
+    CHECK_EQ(r.missed, 199);
+    CHECK_EQ(r.steps, -400);
+}
+
+static void test_accel(void)
+{
+    RESULT slow, fast, faster;
+
+    slow = replay(100, 1, ACCEL_TICKS + US(1000), 0, 0, ACCEL_TICKS);
+    fast = replay(100, 1, ACCEL_TICKS / 2, 0, 0, ACCEL_TICKS);
+    faster = replay(100, 1, ACCEL_TICKS / 8, 0, 0, ACCEL_TICKS);
+    CHECK_EQ(slow.steps, 100);
+    CHECK_EQ(fast.steps, 1 + 99 * 2);
+    CHECK_EQ(faster.steps, 1 + 99 * 4);
+}
+
+static void test_ring_empty(void)
+{
+    static struct encoder_mailbox m;
+    struct encoder_event event = { 1, 2, 3 };
+
+    memset((void *)&m, 0, sizeof(m));
+    CHECK_EQ(encoder_get_event(&m, &event), 0);
+    CHECK_EQ(m.tail, 0);
+    CHECK_EQ(event.time, 1);            // left alone
+
+    // empty again once the one event is read
+    CHECK_EQ(encoder_put_event(&m, 10, ENCODER_EVENT_PRESS, 0), 1);
+    CHECK_EQ(encoder_get_event(&m, &event), 1);
+    CHECK_EQ(event.type, ENCODER_EVENT_PRESS);
+    CHECK_EQ(encoder_get_event(&m, &event), 0);
+    CHECK_EQ(m.head, 1);
+    CHECK_EQ(m.tail, 1);
+}
+
+static void test_ring_full(void)
+{
+    static struct encoder_mailbox m;
+    struct encoder_event event;
+    int i;
+
+    memset((void *)&m, 0, sizeof(m));
+    for (i = 0; i < ENCODER_EVENT_SIZE; ++i)
+        CHECK_EQ(encoder_put_event(&m, 100 + i, ENCODER_EVENT_STEP, i), 1);
+
+    // the events that don't fit are dropped, the ones queued are kept
+    CHECK_EQ(encoder_put_event(&m, 999, ENCODER_EVENT_LONG_PRESS, -1), 0);
+    CHECK_EQ(encoder_put_event(&m, 998, ENCODER_EVENT_LONG_PRESS, -2), 0);
+    CHECK_EQ(m.head, ENCODER_EVENT_SIZE);
+    for (i = 0; i < ENCODER_EVENT_SIZE; ++i) {
+        CHECK_EQ(encoder_get_event(&m, &event), 1);
+        CHECK_EQ(event.time, 100 + i);
+        CHECK_EQ(event.type, ENCODER_EVENT_STEP);
+        CHECK_EQ(event.count, i);
+    }
+    CHECK_EQ(encoder_get_event(&m, &event), 0);
+
+    // one slot freed makes room for one event
+    for (i = 0; i < ENCODER_EVENT_SIZE; ++i)
+        encoder_put_event(&m, i, ENCODER_EVENT_STEP, i);
+    CHECK_EQ(encoder_get_event(&m, &event), 1);
+    CHECK_EQ(encoder_put_event(&m, 50, ENCODER_EVENT_PRESS, 0), 1);
+    CHECK_EQ(encoder_put_event(&m, 51, ENCODER_EVENT_PRESS, 0), 0);
+}
+
+static void test_ring_wrap(void)
+{
+    static const uint32_t starts[] = {
+        0, 0xffffffff - ENCODER_EVENT_SIZE / 2, 0x7fffffff - ENCODER_EVENT_SIZE / 2
+    };
+    static struct encoder_mailbox m;
+    struct encoder_event event;
+    int s, round, i, put, got, ok;
+
+    // slots wrap every ENCODER_EVENT_SIZE events, the counters at 2^32
+    for (s = 0; s < (int)(sizeof(starts) / sizeof(starts[0])); ++s) {
+        memset((void *)&m, 0, sizeof(m));
+        m.head = m.tail = starts[s];
+
+        // put one to three events and take one to four until 4 rings have passed
+        put = got = 0;
+        ok = 1;
+        for (round = 0; got < 4 * ENCODER_EVENT_SIZE && round < 1000; ++round) {
+            for (i = 0; i <= round % 3 && put < 4 * ENCODER_EVENT_SIZE; ++i, ++put)
+                ok &= encoder_put_event(&m, put, ENCODER_EVENT_STEP, put);
+            for (i = 0; i <= round % 4 && encoder_get_event(&m, &event); ++i, ++got)
+                ok &= event.time == (uint32_t)got && event.count == got;
+        }
+        CHECK(ok);
+        CHECK_EQ(m.head, starts[s] + 4 * ENCODER_EVENT_SIZE);
+        CHECK_EQ(m.tail, m.head);
+
+        // a full ring across the wrap
+        m.head = m.tail = starts[s];
+        for (i = 0; i < ENCODER_EVENT_SIZE; ++i)
+            CHECK_EQ(encoder_put_event(&m, i, ENCODER_EVENT_STEP, i), 1);
+        CHECK_EQ(encoder_put_event(&m, i, ENCODER_EVENT_STEP, i), 0);
+        for (i = 0; i < ENCODER_EVENT_SIZE; ++i)
+            CHECK(encoder_get_event(&m, &event) && event.count == i);
+        CHECK_EQ(encoder_get_event(&m, &event), 0);
+    }
+}
+
+// prints the error rate over a range of turning speeds
+static void report(void)
+{
+    static const int periodsUs[] = { 5000, 2000, 1000, 700, 450, 250, 150, 120, 100 };
+    RESULT r;
+    int i;
+
+    srand(3);
+    for (i = 0; i < (int)(sizeof(periodsUs) / sizeof(periodsUs[0])); ++i) {
+        r = replay(1000, 1, US(periodsUs[i]), 0, US(periodsUs[i] / 4), 0);
+        printf("encoder_test: %4d us/step  %5d steps  %4u missed  %5.1f%% error\n",
+               periodsUs[i], r.steps, r.missed, 100.0 * abs(r.steps - 1000) / 1000);
+    }
+}
+
+int main(void)
+{
+    test_clean();
+    test_bounce();
+    test_too_fast();
+    test_accel();
+    test_ring_empty();
+    test_ring_full();
+    test_ring_wrap();
+    report();
+    return test_done("encoder_test");
+}
@@ -0,0 +1,208 @@
+/**
+ * @file fastrand_test.c
+ *
+ * @brief Checks fastrand_range spreads its results evenly, for small and
+ * non-power-of-two ranges in particular, and times it against rand() % n.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fastrand.h"
+#include "test.h"
+
+#define MAX_RANGE   1000
+#define FRAME_CALLS (2 * 300)       // every group of LED_ARENA_LEDS redrawn
+#define FRAMES      20000
+
+static const int ranges[] = { 1, 2, 3, 5, 6, 7, 10, 13, 21, 50, 99, 100, 128, 255, 999, 1000 };
+
+// undoes x ^= x << shift, or x >> shift when right is set
+static uint32_t unshift(uint32_t x, int shift, int right)
+{
+    uint32_t y = x;
+    int i;
+    for (i = 0; i < 32 / shift; ++i)
+        y = x ^ (right ? y >> shift : y << shift);
+    return y;
+}
+
+// the state fastrand steps to value from
+static fastrand_t state_before(uint32_t value)
+{
+    return unshift(unshift(unshift(value, 5, 0), 17, 1), 13, 0);
+}
+
+// the reduction maps the 65536 values of the top half onto n buckets whose
+// sizes are within one of each other
+static void test_reduction(void)
+{
+    static int counts[MAX_RANGE];
+    fastrand_t state;
+    uint32_t top;
+    int i, n, b, lo, hi;
+
+    for (i = 0; i < (int)(sizeof(ranges) / sizeof(ranges[0])); ++i) {
+        n = ranges[i];
+        memset(counts, 0, n * sizeof(int));
+        for (top = 0; top < 65536; ++top) {
+            state = state_before(top << 16 | 0x5a5a);
+            b = fastrand_range(&state, n);
+            if (!CHECK(b >= 0 && b < n))
+                return;
+            ++counts[b];
+        }
+        lo = hi = counts[0];
+        for (b = 1; b < n; ++b) {
+            if (counts[b] < lo)
+                lo = counts[b];
+            if (counts[b] > hi)
+                hi = counts[b];
+        }
+        CHECK(hi - lo <= 1);
+        CHECK_EQ(lo, 65536 / n);
+    }
+}
+
+// chi-squared of the bucket counts of draws samples, against a flat spread
+static double chi_squared(fastrand_t *state, int n, int draws)
+{
+    static int counts[MAX_RANGE];
+    double expect = (double)draws / n, chi = 0, d;
+    int i, r;
+
+    memset(counts, 0, sizeof(counts));
+    for (i = 0; i < draws; ++i) {
+        r = fastrand_range(state, n);
+        if (!CHECK(r >= 0 && r < n))
+            return 1e9;
+        ++counts[r];
+    }
+    for (i = 0; i < n; ++i) {
+        d = counts[i] - expect;
+        chi += d * d / expect;
+    }
+    return chi;
+}
+
+static void test_distribution(void)
+{
+    fastrand_t state;
+    double chi, limit;
+    int i, n;
+
+    fastrand_seed(&state, 12345);
+    for (i = 0; i < (int)(sizeof(ranges) / sizeof(ranges[0])); ++i) {
+        n = ranges[i];
+        chi = chi_squared(&state, n, 1000 * n);
+        // n - 1 degrees of freedom, well past the 99.9th percentile
+        limit = (n - 1) + 6 * sqrt(2.0 * (n - 1)) + 10;
+        if (!CHECK(chi < limit))
+            printf("fastrand_test: range %d chi-squared %.1f over %.1f\n", n, chi, limit);
+    }
+}
+
+// pairs of consecutive small draws are as even as single ones
+static void test_pairs(void)
+{
+    int counts[6][6];
+    fastrand_t state;
+    double chi = 0, expect, d;
+    int i, a, b;
+
+    memset(counts, 0, sizeof(counts));
+    fastrand_seed(&state, 99);
+    for (i = 0; i < 360000; ++i) {
+        a = fastrand_range(&state, 6);
+        b = fastrand_range(&state, 6);
+        ++counts[a][b];
+    }
+    expect = 360000 / 36.0;
+    for (a = 0; a < 6; ++a)
+        for (b = 0; b < 6; ++b) {
+            d = counts[a][b] - expect;
+            chi += d * d / expect;
+        }
+    CHECK(chi < 35 + 6 * sqrt(70.0) + 10);
+}
+
+static void test_edges(void)
+{
+    fastrand_t state;
+    int i;
+
+    state = state_before(0x12345678);
+    CHECK_EQ(fastrand(&state), 0x12345678);
+
+    // a zero seed would stick at zero
+    fastrand_seed(&state, 0);
+    CHECK(state != 0);
+    for (i = 0; i < 1000; ++i)
+        CHECK(fastrand(&state) != 0);
+
+    CHECK_EQ(fastrand_range(&state, 0), 0);
+    CHECK_EQ(fastrand_range(&state, -5), 0);
+    for (i = 0; i < 1000; ++i)
+        CHECK_EQ(fastrand_range(&state, 1), 0);
+    for (i = 0; i < 100000; ++i) {
+        int r = fastrand_range(&state, 65536);
+        if (!CHECK(r >= 0 && r < 65536))
+            break;
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ * prints the host time for a flicker frame's worth of draws, a depth and
+ * a timer for every group, with each generator; the P1 has no divide
+ * instruction so the gap there is wider than on the host
+ */
+static void report(void)
+{
+    static const int depths[] = { 255, 77 };
+    static const int rates[] = { 20, 7 };
+    volatile int sink = 0;
+    fastrand_t state;
+    double start, fast, libc;
+    int i, j, k;
+
+    for (k = 0; k < 2; ++k) {
+        fastrand_seed(&state, 1);
+        start = seconds();
+        for (i = 0; i < FRAMES; ++i)
+            for (j = 0; j < FRAME_CALLS / 2; ++j) {
+                sink += fastrand_range(&state, depths[k]);
+                sink += fastrand_range(&state, rates[k]);
+            }
+        fast = seconds() - start;
+
+        srand(1);
+        start = seconds();
+        for (i = 0; i < FRAMES; ++i)
+            for (j = 0; j < FRAME_CALLS / 2; ++j) {
+                sink += rand() % depths[k];
+                sink += rand() % rates[k];
+            }
+        libc = seconds() - start;
+
+        printf("fastrand_test: depth %3d rate %2d  %d calls/frame  fastrand_range %6.2f us/frame  rand() %% n %6.2f us/frame  %4.1fx\n",
+               depths[k], rates[k], FRAME_CALLS, fast * 1e6 / FRAMES, libc * 1e6 / FRAMES, libc / fast);
+    }
+}
+
+int main(void)
+{
+    test_reduction();
+    test_distribution();
+    test_pairs();
+    test_edges();
+    report();
+    return test_done("fastrand_test");
+}
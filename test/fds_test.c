@@ -0,0 +1,146 @@
+/**
+ * @file fds_test.c
+ *
+ * @brief Checks the FdSerial ring indexes across the wrap.
+ *
+ * The test plays the driver's side of both queues by hand: it drains
+ * txbuff from tx_tail and fills rxbuff at rx_head, a few bytes at a time,
+ * starting from every index so each queue wraps at every point.
+ */
+
+#include <string.h>
+#include <propeller.h>
+#include "fds.h"
+#include "test.h"
+
+#define STREAM      1000
+
+static FdSerial_t port;
+
+// takes up to count bytes from the transmit queue like the driver does
+static int drain(uint8_t *out, int count)
+{
+    int n = 0;
+    while (n < count && port.tx_tail != port.tx_head) {
+        out[n++] = port.txbuff[port.tx_tail];
+        port.tx_tail = (port.tx_tail + 1) & port.buffmask;
+    }
+    return n;
+}
+
+// puts a byte on the receive queue like the driver does, dropping it when full
+static void receive(int byte)
+{
+    int head = (port.rx_head + 1) & port.buffmask;
+    if (head != port.rx_tail) {
+        port.rxbuff[port.rx_head] = byte;
+        port.rx_head = head;
+    }
+}
+
+static void start_at(int index)
+{
+    FdSerial_init(&port, 31, 30, 0, 115200);
+    port.rx_head = port.rx_tail = index;
+    port.tx_head = port.tx_tail = index;
+}
+
+static void test_init(void)
+{
+    FdSerial_init(&port, 31, 30, 0, 115200);
+    CHECK_EQ(port.buffmask, FDSERIAL_BUFF_MASK);
+    CHECK_EQ(FDSERIAL_BUFF_SIZE & FDSERIAL_BUFF_MASK, 0);
+    CHECK_EQ(port.ticks, CLKFREQ / 115200);
+    CHECK_EQ(port.cogId, -1);
+    // the driver finds txbuff straight after rxbuff
+    CHECK(port.txbuff == port.rxbuff + FDSERIAL_BUFF_SIZE);
+    CHECK_EQ(FdSerial_txfree(&port), FDSERIAL_BUFF_SIZE - 1);
+}
+
+static void test_tx(void)
+{
+    char stream[STREAM];
+    uint8_t out[STREAM];
+    int start, sent, received, step, len, n, free;
+
+    for (n = 0; n < STREAM; ++n)
+        stream[n] = (char)(n * 37 + (n >> 8));
+
+    for (start = 0; start < FDSERIAL_BUFF_SIZE; ++start) {
+        start_at(start);
+        sent = received = 0;
+
+        for (step = 0; received < STREAM; ++step) {
+            // offer more than fits now and then, drain unevenly
+            len = (step * 7) % (FDSERIAL_BUFF_SIZE + 9);
+            if (len > STREAM - sent)
+                len = STREAM - sent;
+            free = FdSerial_txfree(&port);
+            n = FdSerial_try_write(&port, stream + sent, len);
+            CHECK_EQ(n, len < free ? len : free);
+            CHECK_EQ(FdSerial_txfree(&port), free - n);
+            sent += n;
+            received += drain(out + received, (step * 5) % 11);
+            if (!CHECK(step < 10 * STREAM))
+                break;
+        }
+
+        CHECK_EQ(sent, STREAM);
+        CHECK(memcmp(stream, out, STREAM) == 0);
+        CHECK_EQ(FdSerial_txfree(&port), FDSERIAL_BUFF_SIZE - 1);
+    }
+}
+
+static void test_tx_full(void)
+{
+    char bytes[FDSERIAL_BUFF_SIZE * 2];
+    uint8_t out[FDSERIAL_BUFF_SIZE * 2];
+    int start;
+
+    memset(bytes, 'x', sizeof(bytes));
+    for (start = 0; start < FDSERIAL_BUFF_SIZE; ++start) {
+        start_at(start);
+        // one slot stays empty so a full queue isn't mistaken for an empty one
+        CHECK_EQ(FdSerial_try_write(&port, bytes, sizeof(bytes)), FDSERIAL_BUFF_SIZE - 1);
+        CHECK_EQ(FdSerial_txfree(&port), 0);
+        CHECK_EQ(FdSerial_try_write(&port, bytes, 1), 0);
+        CHECK_EQ(drain(out, 1), 1);
+        CHECK_EQ(FdSerial_tx(&port, 'y'), -1);
+        CHECK_EQ(FdSerial_txfree(&port), 0);
+        CHECK_EQ(drain(out, sizeof(out)), FDSERIAL_BUFF_SIZE - 1);
+        CHECK_EQ(out[FDSERIAL_BUFF_SIZE - 2], 'y');
+    }
+}
+
+static void test_rx(void)
+{
+    int start, sent, got, byte, i;
+
+    for (start = 0; start < FDSERIAL_BUFF_SIZE; ++start) {
+        start_at(start);
+        CHECK_EQ(FdSerial_rxcheck(&port), -1);
+
+        // every byte value comes back as 0 to 255, never as -1
+        for (sent = got = 0; sent < 256; ) {
+            for (i = 0; i < 3 && sent < 256; ++i)
+                receive(sent++);
+            while ((byte = FdSerial_rxcheck(&port)) != -1)
+                CHECK_EQ(byte, got++);
+        }
+        CHECK_EQ(got, 256);
+
+        for (i = 0; i < FDSERIAL_BUFF_SIZE + 5; ++i)
+            receive(i);
+        FdSerial_rxflush(&port);
+        CHECK_EQ(FdSerial_rxcheck(&port), -1);
+    }
+}
+
+int main(void)
+{
+    test_init();
+    test_tx();
+    test_tx_full();
+    test_rx();
+    return test_done("fds_test");
+}
@@ -0,0 +1,165 @@
+/**
+ * @file lcd_test.c
+ *
+ * @brief Runs the LCD shadow buffer against a fake panel that counts the
+ * bytes it is sent.
+ *
+ * The fake panel acts on cursor moves and characters like the serial LCD
+ * and takes at most room bytes per write so flushes get cut short. After
+ * the last column it leaves the cursor somewhere unhelpful, since the real
+ * panel's behaviour there isn't relied on.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "lcd.h"
+#include "test.h"
+
+static char screen[LCD_ROWS][LCD_COLS];
+static int cursor;
+static int room;
+static uint32_t received;
+
+static int fake_write(void *port, const char *buf, int len)
+{
+    int i;
+
+    (void)port;
+    if (len > room)
+        len = room;
+    for (i = 0; i < len; ++i) {
+        uint8_t byte = buf[i];
+        if (byte >= LCD_MOVE_CURSOR)
+            cursor = byte - LCD_MOVE_CURSOR;
+        else {
+            int row = cursor / LCD_ROW_STRIDE;
+            int col = cursor % LCD_ROW_STRIDE;
+            if (row < LCD_ROWS && col < LCD_COLS)
+                screen[row][col] = byte;
+            cursor = col + 1 < LCD_COLS ? cursor + 1 : 77;
+        }
+    }
+    room -= len;
+    received += len;
+    return len;
+}
+
+static void start(LCD_STATE *lcd)
+{
+    memset(screen, ' ', sizeof(screen));
+    cursor = 0;
+    room = 1000;
+    lcd_init(lcd, fake_write, NULL);
+}
+
+// flushes until done with room bytes per try, returns the bytes sent
+static uint32_t flush(LCD_STATE *lcd, int perTry)
+{
+    uint32_t before = received;
+    int tries;
+
+    for (tries = 0; tries < 100; ++tries) {
+        room = perTry;
+        if (lcd_flush(lcd))
+            break;
+    }
+    CHECK(tries < 100);
+    CHECK(memcmp(screen, lcd->shadow, sizeof(screen)) == 0);
+    CHECK_EQ(cursor, lcd->cursor);
+    CHECK_EQ(received - before, lcd->bytesSent);
+    lcd->bytesSent = 0;
+    return received - before;
+}
+
+static void test_counts(void)
+{
+    LCD_STATE lcd;
+
+    start(&lcd);
+    CHECK_EQ(flush(&lcd, 1000), 0);
+
+    // one character: a cursor move and the character
+    lcd_put_str(&lcd, 0, 3, "x");
+    lcd_move_cursor(&lcd, 0, 4);
+    CHECK_EQ(flush(&lcd, 1000), 2);
+
+    // the same text again sends nothing
+    lcd_put_str(&lcd, 0, 3, "x");
+    CHECK_EQ(flush(&lcd, 1000), 0);
+
+    // a run of changes takes one cursor move
+    lcd_put_str(&lcd, 1, 2, "abcd");
+    lcd_move_cursor(&lcd, 1, 6);
+    CHECK_EQ(flush(&lcd, 1000), 1 + 4);
+
+    // two runs take two, plus one to put the cursor back
+    lcd_put_str(&lcd, 1, 2, "AbcD");
+    lcd_move_cursor(&lcd, 0, 0);
+    CHECK_EQ(flush(&lcd, 1000), 1 + 1 + 1 + 1 + 1);
+
+    // writing the last column loses track of the cursor
+    lcd_put_str(&lcd, 0, LCD_COLS - 1, "z");
+    lcd_move_cursor(&lcd, 0, LCD_COLS);
+    CHECK_EQ(flush(&lcd, 1000), 1 + 1 + 1);
+
+    // text past the end of a row is dropped
+    lcd_put_str(&lcd, 0, LCD_COLS - 2, "pqrs");
+    CHECK_EQ(screen[1][0], ' ');
+    flush(&lcd, 1000);
+}
+
+// what redrawing the adjuster line used to cost: label, value, cursor move
+static void test_adjuster(void)
+{
+    char value[4];
+    uint32_t total = 0, before;
+    LCD_STATE lcd;
+    int step;
+
+    start(&lcd);
+    lcd_put_str(&lcd, 0, 0, "L50 R88 G47 B14");
+    lcd_put_str(&lcd, 1, 0, "#1 P02 D21 S99");
+    lcd_move_cursor(&lcd, 0, 4);
+    flush(&lcd, 7);
+
+    for (step = 0; step < 20; ++step) {
+        sprintf(value, "%02d", 88 - step);
+        lcd_put_str(&lcd, 0, 5, value);
+        lcd_move_cursor(&lcd, 0, 4);
+        total += flush(&lcd, 1000);
+    }
+
+    // a change in both digits costs 4 bytes, in one digit 3
+    before = 20 * (1 + 1 + 1 + 2 + 1);
+    CHECK(total < before);
+    printf("lcd_test: 20 encoder steps sent %u bytes, %u redrawing\n", total, before);
+}
+
+static void test_random(void)
+{
+    static const char letters[] = " abc";
+    LCD_STATE lcd;
+    char text[8];
+    int round, i, len;
+
+    srand(12345);
+    start(&lcd);
+    for (round = 0; round < 2000; ++round) {
+        len = rand() % 6;
+        for (i = 0; i < len; ++i)
+            text[i] = letters[rand() % 4];
+        text[len] = '\0';
+        lcd_put_str(&lcd, rand() % LCD_ROWS, rand() % (LCD_COLS + 2) - 1, text);
+        if (rand() % 3 == 0)
+            lcd_move_cursor(&lcd, rand() % LCD_ROWS, rand() % LCD_COLS);
+        flush(&lcd, 1 + rand() % 6);
+    }
+}
+
+int main(void)
+{
+    test_counts();
+    test_adjuster();
+    test_random();
+    return test_done("lcd_test");
+}
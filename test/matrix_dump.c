@@ -0,0 +1,87 @@
+/**
+ * @file matrix_dump.c
+ *
+ * @brief Draws the matrix coordinate table for every wiring as PPM images.
+ *
+ * Each pixel is a square shaded from blue at the start of the strip to red
+ * at the end, with row 0 at the bottom as on the matrix, so the path the
+ * strip takes can be checked against the panel by eye.
+ *
+ * usage: matrix_dump [width height [prefix]]
+ *
+ * writes prefix<wiring>.ppm for each wiring, matrix_ by default.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "matrix.h"
+
+#define CELL        16          // image pixels per LED, the last row and column dark
+#define MAX_PIXELS  4096
+
+static const struct {
+    int wiring;
+    const char *name;
+} wirings[] = {
+    { MATRIX_ROWS, "rows" },
+    { MATRIX_SERPENTINE, "serpentine" },
+    { MATRIX_COLUMNS, "columns" },
+    { MATRIX_COLUMN_SERPENTINE, "column_serpentine" },
+    { MATRIX_ROWS | MATRIX_START_TOP, "rows_top" },
+    { MATRIX_SERPENTINE | MATRIX_START_TOP, "serpentine_top" },
+    { MATRIX_COLUMNS | MATRIX_START_TOP, "columns_top" },
+    { MATRIX_COLUMN_SERPENTINE | MATRIX_START_TOP, "column_serpentine_top" },
+};
+
+static int dump(const MATRIX *m, const char *path)
+{
+    FILE *fp;
+    int x, y, i, j, pos, last = m->width * m->height - 1;
+
+    if (!(fp = fopen(path, "wb"))) {
+        perror(path);
+        return -1;
+    }
+    fprintf(fp, "P6\n%d %d\n255\n", m->width * CELL, m->height * CELL);
+
+    // the image starts at the top row
+    for (y = m->height - 1; y >= 0; --y)
+        for (j = 0; j < CELL; ++j)
+            for (x = 0; x < m->width; ++x) {
+                pos = matrix_index(m, x, y);
+                for (i = 0; i < CELL; ++i) {
+                    int on = i < CELL - 1 && j < CELL - 1;
+                    int red = last ? 255 * pos / last : 255;
+                    putc(on ? red : 0, fp);
+                    putc(on && pos == 0 ? 255 : 0, fp);     // the first LED is white
+                    putc(on ? 255 - red : 0, fp);
+                }
+            }
+
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    static uint16_t map[MAX_PIXELS];
+    const char *prefix = argc > 3 ? argv[3] : "matrix_";
+    int width = argc > 2 ? atoi(argv[1]) : 16;
+    int height = argc > 2 ? atoi(argv[2]) : 8;
+    char path[256];
+    MATRIX m;
+    int i;
+
+    if (width <= 0 || height <= 0 || width * height > MAX_PIXELS) {
+        fprintf(stderr, "usage: matrix_dump [width height [prefix]], at most %d pixels\n", MAX_PIXELS);
+        return 1;
+    }
+
+    for (i = 0; i < (int)(sizeof(wirings) / sizeof(wirings[0])); ++i) {
+        matrix_init(&m, map, width, height, wirings[i].wiring);
+        snprintf(path, sizeof(path), "%s%s.ppm", prefix, wirings[i].name);
+        if (dump(&m, path) < 0)
+            return 1;
+        printf("%s\n", path);
+    }
+    return 0;
+}
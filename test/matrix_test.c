@@ -0,0 +1,139 @@
+/**
+ * @file matrix_test.c
+ *
+ * @brief Checks the matrix coordinate table and the span fill and copy
+ * against per-pixel reference code.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "matrix.h"
+#include "test.h"
+
+#define MAX_WIDTH   9
+#define MAX_HEIGHT  6
+#define MAX_PIXELS  (MAX_WIDTH * MAX_HEIGHT)
+
+static const int wirings[] = {
+    MATRIX_ROWS, MATRIX_SERPENTINE, MATRIX_COLUMNS, MATRIX_COLUMN_SERPENTINE
+};
+
+static void test_known(void)
+{
+    // 4 x 3, strip position of each pixel with row 0 at the bottom
+    static const uint16_t serpentine[12] = { 0, 1, 2, 3, 7, 6, 5, 4, 8, 9, 10, 11 };
+    static const uint16_t serpentineTop[12] = { 8, 9, 10, 11, 7, 6, 5, 4, 0, 1, 2, 3 };
+    static const uint16_t columns[12] = { 0, 3, 6, 9, 1, 4, 7, 10, 2, 5, 8, 11 };
+    static const uint16_t columnSerpentine[12] = { 0, 5, 6, 11, 1, 4, 7, 10, 2, 3, 8, 9 };
+    uint16_t map[12];
+    MATRIX m;
+
+    matrix_init(&m, map, 4, 3, MATRIX_SERPENTINE);
+    CHECK(memcmp(map, serpentine, sizeof(map)) == 0);
+    matrix_init(&m, map, 4, 3, MATRIX_SERPENTINE | MATRIX_START_TOP);
+    CHECK(memcmp(map, serpentineTop, sizeof(map)) == 0);
+    matrix_init(&m, map, 4, 3, MATRIX_COLUMNS);
+    CHECK(memcmp(map, columns, sizeof(map)) == 0);
+    matrix_init(&m, map, 4, 3, MATRIX_COLUMN_SERPENTINE);
+    CHECK(memcmp(map, columnSerpentine, sizeof(map)) == 0);
+    CHECK_EQ(matrix_index(&m, 1, 0), 5);
+}
+
+static void test_maps(void)
+{
+    uint16_t map[MAX_PIXELS];
+    int pixelAt[MAX_PIXELS];
+    int w, h, i, top, wiring, serpentine, x, y, dx, dy;
+    MATRIX m;
+
+    for (i = 0; i < (int)(sizeof(wirings) / sizeof(wirings[0])); ++i)
+    for (top = 0; top <= MATRIX_START_TOP; top += MATRIX_START_TOP)
+    for (w = 1; w <= MAX_WIDTH; ++w)
+    for (h = 1; h <= MAX_HEIGHT; ++h) {
+        wiring = wirings[i] | top;
+        matrix_init(&m, map, w, h, wiring);
+
+        // every strip position is used exactly once
+        memset(pixelAt, -1, sizeof(pixelAt));
+        for (y = 0; y < h; ++y)
+            for (x = 0; x < w; ++x) {
+                int index = matrix_index(&m, x, y);
+                if (CHECK(index >= 0 && index < w * h) && CHECK(pixelAt[index] < 0))
+                    pixelAt[index] = y * w + x;
+            }
+
+        // serpentine strips only step to a neighbouring pixel
+        serpentine = wirings[i] == MATRIX_SERPENTINE || wirings[i] == MATRIX_COLUMN_SERPENTINE;
+        for (x = 1; serpentine && x < w * h; ++x) {
+            dx = abs(pixelAt[x] % w - pixelAt[x - 1] % w);
+            dy = abs(pixelAt[x] / w - pixelAt[x - 1] / w);
+            CHECK_EQ(dx + dy, 1);
+        }
+    }
+}
+
+static void fill_buf(uint32_t *buf, int count)
+{
+    int i;
+    for (i = 0; i < count; ++i)
+        buf[i] = 0x1000 + i;
+}
+
+static void test_spans(void)
+{
+    uint16_t map[MAX_PIXELS];
+    uint32_t buf[MAX_PIXELS], ref[MAX_PIXELS];
+    int i, top, w, h, y, src, x, x0, x1, count;
+    MATRIX m;
+
+    for (i = 0; i < (int)(sizeof(wirings) / sizeof(wirings[0])); ++i)
+    for (top = 0; top <= MATRIX_START_TOP; top += MATRIX_START_TOP)
+    for (w = 1; w <= MAX_WIDTH; w += 2)
+    for (h = 1; h <= MAX_HEIGHT; ++h) {
+        matrix_init(&m, map, w, h, wirings[i] | top);
+
+        for (x0 = -2; x0 <= w + 1; ++x0)
+        for (x1 = x0 - 1; x1 <= w + 2; ++x1) {
+            for (y = 0; y < h; ++y) {
+                fill_buf(buf, w * h);
+                fill_buf(ref, w * h);
+                for (count = 0, x = x0; x < x1; ++x)
+                    if (x >= 0 && x < w) {
+                        ref[matrix_index(&m, x, y)] = 7;
+                        ++count;
+                    }
+                CHECK_EQ(matrix_fill_span(&m, buf, y, x0, x1, 7), count);
+                CHECK(memcmp(buf, ref, w * h * sizeof(uint32_t)) == 0);
+            }
+
+            for (y = 0; y < h; ++y)
+            for (src = 0; src < h; ++src) {
+                if (src == y)
+                    continue;
+                fill_buf(buf, w * h);
+                fill_buf(ref, w * h);
+                for (x = x0; x < x1; ++x)
+                    if (x >= 0 && x < w)
+                        ref[matrix_index(&m, x, y)] = ref[matrix_index(&m, x, src)];
+                matrix_copy_span(&m, buf, y, src, x0, x1);
+                CHECK(memcmp(buf, ref, w * h * sizeof(uint32_t)) == 0);
+            }
+        }
+
+        // copying row 0 up the matrix gives every row the same pixels
+        fill_buf(buf, w * h);
+        for (y = 1; y < h; ++y)
+            matrix_copy_row(&m, buf, y, 0);
+        for (y = 0; y < h; ++y)
+            for (x = 0; x < w; ++x)
+                CHECK_EQ(buf[matrix_index(&m, x, y)], 0x1000 + matrix_index(&m, x, 0));
+    }
+}
+
+int main(void)
+{
+    test_known();
+    test_maps();
+    test_spans();
+    return test_done("matrix_test");
+}
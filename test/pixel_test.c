@@ -0,0 +1,119 @@
+/**
+ * @file pixel_test.c
+ *
+ * @brief Checks the pixel.h helpers against plain per-channel arithmetic.
+ *
+ * Every pair of channel values goes through every channel at once, with
+ * the other channels holding different values so a carry or borrow that
+ * leaks into a neighbour shows up. The top byte of the inputs is set to
+ * check it is ignored.
+ */
+
+#include "pixel.h"
+#include "test.h"
+
+#define CHANNEL(c, n)   (((c) >> (8 * (n))) & 0xff)
+
+static uint32_t make_pixel(uint32_t r, uint32_t g, uint32_t b)
+{
+    return 0xa5000000 | (r << 16) | (g << 8) | b;
+}
+
+static uint32_t sub(uint32_t a, uint32_t b)
+{
+    return a > b ? a - b : 0;
+}
+
+static uint32_t add(uint32_t a, uint32_t b)
+{
+    return a + b < 255 ? a + b : 255;
+}
+
+static uint32_t scale(uint32_t x, uint32_t level)
+{
+    return x * level / 255;
+}
+
+// checks all three channels of result against the scalar results
+static void check_channels(uint32_t result, const uint32_t expect[3])
+{
+    int n;
+    CHECK_EQ(result >> 24, 0);
+    for (n = 0; n < 3; ++n)
+        CHECK_EQ(CHANNEL(result, n), expect[n]);
+}
+
+static void test_splat(void)
+{
+    uint32_t v, expect[3];
+    for (v = 0; v < 256; ++v) {
+        expect[0] = expect[1] = expect[2] = v;
+        check_channels(pixel_splat(0xa5a5a500 | v), expect);
+    }
+}
+
+static void test_add_sub(void)
+{
+    uint32_t x, y, a, b, ca[3], cb[3], expect[3];
+    int n;
+
+    for (x = 0; x < 256; ++x) {
+        for (y = 0; y < 256; ++y) {
+            // x and y in every channel, the pair swapped or mixed in the others
+            ca[0] = x; ca[1] = y; ca[2] = x ^ y;
+            cb[0] = y; cb[1] = x; cb[2] = 255 - y;
+            a = make_pixel(ca[2], ca[1], ca[0]);
+            b = make_pixel(cb[2], cb[1], cb[0]);
+
+            for (n = 0; n < 3; ++n)
+                expect[n] = sub(ca[n], cb[n]);
+            check_channels(pixel_sub(a, b), expect);
+
+            for (n = 0; n < 3; ++n)
+                expect[n] = add(ca[n], cb[n]);
+            check_channels(pixel_add(a, b), expect);
+        }
+    }
+}
+
+static void test_scale(void)
+{
+    uint32_t x, level, c, expect[3];
+
+    for (x = 0; x < 256; ++x) {
+        c = make_pixel(x, 255 - x, x ^ 0x5a);
+        for (level = 0; level < 256; ++level) {
+            expect[2] = scale(x, level);
+            expect[1] = scale(255 - x, level);
+            expect[0] = scale(x ^ 0x5a, level);
+            check_channels(pixel_scale(c, level), expect);
+        }
+    }
+}
+
+static void test_blend(void)
+{
+    uint32_t x, y, t, a, b, expect[3];
+
+    for (x = 0; x < 256; ++x) {
+        for (y = 0; y < 256; ++y) {
+            a = make_pixel(x, y, 255 - x);
+            b = make_pixel(y, x, 255 - y);
+            for (t = 0; t < 256; ++t) {
+                expect[2] = scale(x, 255 - t) + scale(y, t);
+                expect[1] = scale(y, 255 - t) + scale(x, t);
+                expect[0] = scale(255 - x, 255 - t) + scale(255 - y, t);
+                check_channels(pixel_blend(a, b, t), expect);
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    test_splat();
+    test_add_sub();
+    test_scale();
+    test_blend();
+    return test_done("pixel_test");
+}
@@ -0,0 +1,103 @@
+/**
+ * @file propeller.h
+ *
+ * @brief Host stand-in for the parts of PropGCC's propeller.h the tested
+ * sources use.
+ *
+ * CNT counts at CLKFREQ from the host's monotonic clock and cogstart runs
+ * the C function on a thread. There is no PASM on the host so cognew never
+ * finds a cog; tests that need a driver run a fake one of their own on a
+ * thread against the same mailbox.
+ *
+ * A test built with HOST_PINS supplies CNT and the pin registers itself.
+ * Every OUTA, DIRA or INA access calls host_pin first, so a device model
+ * sees each change the code under test makes, in order, before the next
+ * one happens.
+ */
+
+#ifndef __TEST_PROPELLER_H__
+#define __TEST_PROPELLER_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#define CLKFREQ             80000000
+#define _CLKFREQ            CLKFREQ
+#define _clkfreq            CLKFREQ
+
+#ifdef HOST_PINS
+
+#define HOST_OUTA           0
+#define HOST_DIRA           1
+#define HOST_INA            2
+
+#define CNT                 host_cnt()
+#define OUTA                (*host_pin(HOST_OUTA))
+#define DIRA                (*host_pin(HOST_DIRA))
+#define INA                 (*host_pin(HOST_INA))
+
+uint32_t host_cnt(void);
+volatile uint32_t *host_pin(int reg);
+
+#else
+
+#define CNT                 host_cnt()
+
+#endif
+
+#define _COGMEM
+#define _NATIVE
+#define EXTRA_STACK_LONGS   16
+
+#define cognew(code, par)   ((void)(code), (void)(par), -1)
+#define cogstop(id)         ((void)(id))
+
+#ifndef HOST_PINS
+static inline uint32_t host_cnt(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * CLKFREQ + now.tv_nsec / (1000000000 / CLKFREQ));
+}
+#endif
+
+static inline void waitcnt(uint32_t target)
+{
+    while ((int32_t)(target - CNT) > 0)
+        ;
+}
+
+typedef struct {
+    void (*func)(void *);
+    void *par;
+} HOST_COG;
+
+static inline void *host_cog_run(void *arg)
+{
+    HOST_COG cog = *(HOST_COG *)arg;
+    __atomic_store_n(&((HOST_COG *)arg)->func, (void (*)(void *))0, __ATOMIC_RELEASE);
+    cog.func(cog.par);
+    return 0;
+}
+
+// the stack is left unused, the thread gets one of its own
+static inline int cogstart(void (*func)(void *), void *par, void *stack, int stackSize)
+{
+    static int nextCog = 1;
+    HOST_COG cog = { func, par };
+    pthread_t thread;
+
+    (void)stack;
+    (void)stackSize;
+    if (pthread_create(&thread, 0, host_cog_run, &cog) != 0)
+        return -1;
+    pthread_detach(thread);
+
+    // the thread copies its arguments before starting the function
+    while (__atomic_load_n(&cog.func, __ATOMIC_ACQUIRE))
+        ;
+    return nextCog++;
+}
+
+#endif
@@ -0,0 +1,175 @@
+/**
+ * @file render_test.c
+ *
+ * @brief Runs the render pool with threads standing in for the worker
+ * cogs, checks the frame barrier and measures how rendering the effects
+ * scales from 1 to RENDER_TEST_SEGMENTS segments.
+ *
+ * Workers never stop, so each pool runs in a child process of its own to
+ * keep their spinning out of the other measurements. The timings only
+ * mean something on a host with a core for each segment; the barrier
+ * checks hold either way.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <propeller.h>
+#include "render.h"
+#include "effects.h"
+#include "test.h"
+
+#ifndef RENDER_TEST_SEGMENTS
+#define RENDER_TEST_SEGMENTS    4
+#endif
+
+#define WIDTH       256
+#define HEIGHT      32
+#define PIXELS      (WIDTH * HEIGHT)
+#define FRAMES      20
+#define STACK_SIZE  256
+
+static RENDER_POOL pool;
+static uint8_t stacks[RENDER_MAX_SEGMENTS][STACK_SIZE];
+
+typedef struct {
+    volatile uint32_t calls[RENDER_MAX_SEGMENTS];   // frames rendered by each segment
+    volatile uint32_t frame;                        // frame the caller is in
+    volatile int early;                             // segments that ran outside a frame
+} BARRIER_JOB;
+
+static int barrier_segment(void *arg, int segment)
+{
+    BARRIER_JOB *job = arg;
+    if (job->calls[segment] + 1 != job->frame)
+        ++job->early;
+    ++job->calls[segment];
+    return segment + 1;
+}
+
+// checks every segment runs exactly once per frame and is done on return
+static int check_barrier(int segments)
+{
+    BARRIER_JOB job;
+    int frame, i, expect = 0;
+
+    memset(&job, 0, sizeof(job));
+    for (i = 1; i <= segments; ++i)
+        expect += i;
+
+    for (frame = 1; frame <= FRAMES; ++frame) {
+        job.frame = frame;
+        CHECK_EQ(render_frame(&pool, barrier_segment, &job), expect);
+        for (i = 0; i < segments; ++i)
+            CHECK_EQ(job.calls[i], frame);
+    }
+    CHECK_EQ(job.early, 0);
+    return 0;
+}
+
+typedef struct {
+    const EFFECT *effect;
+    EFFECT_CONTEXT *ctx;
+    uint32_t *buf;
+} EFFECT_JOB;
+
+static int effect_segment(void *arg, int segment)
+{
+    EFFECT_JOB *job = arg;
+    return job->effect->render(job->ctx, job->buf, segment);
+}
+
+static double now_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+// renders FRAMES frames of an effect, returns microseconds per frame
+static double time_effect(const EFFECT *effect, int segments)
+{
+    static uint16_t map[PIXELS];
+    static uint32_t buf[PIXELS];
+    static uint8_t scratch[3 * PIXELS];
+    EFFECT_SETTINGS settings = effect->defaults;
+    EFFECT_CONTEXT ctx;
+    EFFECT_JOB job = { effect, &ctx, buf };
+    MATRIX matrix;
+    double start;
+    int frame, i, unset;
+
+    matrix_init(&matrix, map, WIDTH, HEIGHT, MATRIX_SERPENTINE);
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.matrix = &matrix;
+    ctx.color = 0xff8020;
+    ctx.buffers = 1;
+    ctx.scratch = scratch;
+    ctx.scratchSize = sizeof(scratch);
+    ctx.segments = segments;
+    for (i = 0; i < segments; ++i)
+        fastrand_seed(&ctx.rng[i], 1 + i);
+    effect->init(&ctx);
+    effect->params(&ctx, &settings);
+
+    // the first frame writes every pixel once between the segments
+    memset(buf, 0xff, sizeof(buf));
+    CHECK_EQ(render_frame(&pool, effect_segment, &job), PIXELS);
+    for (i = unset = 0; i < PIXELS; ++i)
+        unset += buf[i] == 0xffffffff;
+    CHECK_EQ(unset, 0);
+
+    start = now_us();
+    for (frame = 0; frame < FRAMES; ++frame)
+        render_frame(&pool, effect_segment, &job);
+    return (now_us() - start) / FRAMES;
+}
+
+// starts a pool with the given segments and runs the checks in a child
+static void run_pool(int segments, double *usPerFrame)
+{
+    int fds[2], status, i;
+    pid_t pid;
+
+    if (pipe(fds) != 0 || (pid = fork()) < 0) {
+        CHECK(0);
+        return;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        CHECK_EQ(render_start(&pool, segments - 1, stacks, STACK_SIZE), segments);
+        check_barrier(segments);
+        for (i = 0; i < EFFECT_COUNT; ++i)
+            usPerFrame[i] = time_effect(&effects[i], segments);
+        if (write(fds[1], usPerFrame, EFFECT_COUNT * sizeof(double)) < 0)
+            ++testFailures;
+        _exit(test_done("render_test pool") != 0);
+    }
+
+    close(fds[1]);
+    CHECK(read(fds[0], usPerFrame, EFFECT_COUNT * sizeof(double)) == EFFECT_COUNT * sizeof(double));
+    close(fds[0]);
+    CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main(void)
+{
+    double us[RENDER_TEST_SEGMENTS + 1][EFFECT_COUNT];
+    int segments, i;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+    printf("render_test: %d x %d pixels, %ld cpus\n", WIDTH, HEIGHT, sysconf(_SC_NPROCESSORS_ONLN));
+    for (segments = 1; segments <= RENDER_TEST_SEGMENTS; ++segments) {
+        run_pool(segments, us[segments]);
+        for (i = 0; i < EFFECT_COUNT; ++i)
+            printf("render_test: %-8s %d segments %8.1f us/frame  %4.2fx\n",
+                   effects[i].name, segments, us[segments][i], us[1][i] / us[segments][i]);
+    }
+
+    // asking for more workers than segments starts as many as fit
+    CHECK_EQ(render_start(&pool, RENDER_MAX_SEGMENTS + 2, stacks, STACK_SIZE), RENDER_MAX_SEGMENTS);
+    return test_done("render_test");
+}
@@ -0,0 +1,160 @@
+/**
+ * @file sched_test.c
+ *
+ * @brief Drives the frame scheduler from a simulated CNT.
+ *
+ * Each frame takes a given number of ticks from the time the previous
+ * waitcnt returned, and the test waits for the deadline sched_next gives
+ * the way do_flame does. Clocks start just before CNT wraps.
+ */
+
+#include "sched.h"
+#include "test.h"
+
+#define PERIOD          800000      // 10 ms at 80MHz
+#define START_TIME      0xffff0000
+
+static uint32_t now;
+
+// runs a frame of work ticks and waits for its deadline
+static uint32_t frame(FRAME_SCHED *s, uint32_t work)
+{
+    uint32_t deadline;
+
+    now += work;
+    deadline = sched_next(s, now);
+    if ((int32_t)(deadline - now) > 0)
+        now = deadline;
+    return deadline;
+}
+
+static void test_steady(void)
+{
+    FRAME_SCHED s;
+    uint32_t start = START_TIME, deadline, last;
+    int i;
+
+    now = start;
+    sched_start(&s, now, PERIOD);
+    last = frame(&s, 1000);
+    CHECK_EQ(last, start + PERIOD);
+
+    // work that varies doesn't move the deadlines
+    for (i = 1; i < 100; ++i) {
+        deadline = frame(&s, (i * 7919) % (PERIOD - SCHED_MARGIN));
+        CHECK_EQ(deadline - last, PERIOD);
+        last = deadline;
+    }
+    CHECK_EQ(last, start + 100 * PERIOD);
+    CHECK_EQ(s.frames, 100);
+    CHECK_EQ(s.overruns, 0);
+    CHECK_EQ(s.dropped, 0);
+}
+
+static void test_margin(void)
+{
+    FRAME_SCHED s;
+    uint32_t deadline;
+
+    // finishing SCHED_MARGIN ticks early is still in time
+    now = START_TIME;
+    sched_start(&s, now, PERIOD);
+    deadline = frame(&s, PERIOD - SCHED_MARGIN);
+    CHECK_EQ(deadline, START_TIME + PERIOD);
+    CHECK_EQ(s.overruns, 0);
+
+    // any closer and waitcnt could miss it, so the frame is late
+    deadline = frame(&s, PERIOD - SCHED_MARGIN + 1);
+    CHECK_EQ(deadline, START_TIME + 3 * PERIOD);
+    CHECK_EQ(s.overruns, 1);
+    CHECK_EQ(s.dropped, 1);
+
+    // the next deadline is never within SCHED_MARGIN of now
+    now = START_TIME;
+    sched_start(&s, now, PERIOD);
+    deadline = frame(&s, 2 * PERIOD - SCHED_MARGIN + 1);
+    CHECK((int32_t)(deadline - (START_TIME + 2 * PERIOD - SCHED_MARGIN + 1)) >= SCHED_MARGIN);
+    CHECK_EQ(deadline, START_TIME + 3 * PERIOD);
+    CHECK_EQ(s.dropped, 2);
+}
+
+static void test_overrun(void)
+{
+    FRAME_SCHED s;
+    uint32_t deadline, last;
+
+    now = START_TIME;
+    sched_start(&s, now, PERIOD);
+    last = frame(&s, 1000);
+
+    // a frame two and a half periods long drops two periods
+    deadline = frame(&s, 5 * PERIOD / 2);
+    CHECK_EQ(s.overruns, 1);
+    CHECK_EQ(s.dropped, 2);
+    CHECK_EQ(deadline - last, 3 * PERIOD);
+    CHECK_EQ(now, deadline);
+
+    // and the frames after it are back on the timebase
+    last = deadline;
+    deadline = frame(&s, 1000);
+    CHECK_EQ(deadline - last, PERIOD);
+    CHECK_EQ((deadline - START_TIME) % PERIOD, 0);
+    CHECK_EQ(s.frames, 3);
+    CHECK_EQ(s.overruns, 1);
+
+    // a frame just past its deadline drops one
+    deadline = frame(&s, PERIOD + 1);
+    CHECK_EQ(s.overruns, 2);
+    CHECK_EQ(s.dropped, 3);
+    CHECK_EQ((deadline - START_TIME) % PERIOD, 0);
+
+    // every frame late: one overrun each, the counts stay consistent
+    deadline = frame(&s, 3 * PERIOD / 2);
+    deadline = frame(&s, 3 * PERIOD / 2);
+    CHECK_EQ(s.frames, 6);
+    CHECK_EQ(s.overruns, 4);
+    CHECK_EQ((deadline - START_TIME) / PERIOD, s.frames + s.dropped);
+}
+
+static void test_wrap(void)
+{
+    FRAME_SCHED s;
+    uint32_t deadline, last;
+    int i;
+
+    // the first deadline is past the wrap
+    now = 0xffffffff - PERIOD / 2;
+    sched_start(&s, now, PERIOD);
+    CHECK(s.deadline < now);
+    deadline = frame(&s, 1000);
+    CHECK_EQ(deadline, (uint32_t)(0xffffffff - PERIOD / 2 + PERIOD));
+    CHECK_EQ(s.overruns, 0);
+
+    // late across the wrap, with now still before it
+    now = 0xffffffff - PERIOD / 2;
+    sched_start(&s, now, PERIOD);
+    deadline = frame(&s, PERIOD + 1000);
+    CHECK_EQ(s.overruns, 1);
+    CHECK_EQ(s.dropped, 1);
+    CHECK_EQ(deadline, (uint32_t)(0xffffffff - PERIOD / 2 + 2 * PERIOD));
+
+    // periods that don't divide 2^32 run straight through it
+    now = 0xffffffff - 10 * PERIOD;
+    sched_start(&s, now, PERIOD + 3);
+    last = s.deadline - (PERIOD + 3);
+    for (i = 0; i < 20; ++i) {
+        deadline = frame(&s, PERIOD / 2);
+        CHECK_EQ(deadline - last, PERIOD + 3);
+        last = deadline;
+    }
+    CHECK_EQ(s.overruns, 0);
+}
+
+int main(void)
+{
+    test_steady();
+    test_margin();
+    test_overrun();
+    test_wrap();
+    return test_done("sched_test");
+}
@@ -0,0 +1,131 @@
+/**
+ * @file store_test.c
+ *
+ * @brief Cuts the power at every byte of every save and checks the store
+ * comes back with either the old record or the new one.
+ *
+ * eeprom_read and eeprom_write work on an array here. An armed cut lets
+ * the write store that many bytes, scribbles over the byte it was cut in
+ * and drops the rest, the way a page write torn part way through can
+ * leave it.
+ */
+
+#include <string.h>
+#include "store.h"
+#include "test.h"
+
+#define BASE        0x400
+#define SLOT_SIZE   32
+#define SLOTS       5
+#define SAVES       (3 * SLOTS + 2)         // several passes round the ring
+
+typedef struct {
+    uint32_t count;
+    uint8_t fill[12];
+} RECORD;
+
+static uint8_t eeprom[0x10000];
+static int cut = -1;                        // bytes the next write stores, -1 for all
+
+int32_t eeprom_read(uint32_t addr, uint8_t *ptr, uint32_t count)
+{
+    if (addr + count > sizeof(eeprom))
+        return EEPROM_ERR_NAK;
+    memcpy(ptr, &eeprom[addr], count);
+    return count;
+}
+
+int32_t eeprom_write(uint32_t addr, uint8_t *ptr, uint32_t count)
+{
+    if (addr + count > sizeof(eeprom))
+        return EEPROM_ERR_NAK;
+    if (cut >= 0 && cut < (int)count) {
+        memcpy(&eeprom[addr], ptr, cut);
+        eeprom[addr + cut] ^= 0x5a;
+        cut = -1;
+        return EEPROM_ERR_NAK;
+    }
+    memcpy(&eeprom[addr], ptr, count);
+    return count;
+}
+
+static void make_record(RECORD *record, uint32_t count)
+{
+    record->count = count;
+    memset(record->fill, (int)count * 7, sizeof(record->fill));
+}
+
+// loads the store from scratch, returns the count of the record found or 0
+static uint32_t reload(STORE *store)
+{
+    RECORD record, expect;
+    int ret;
+
+    store_init(store, BASE, SLOT_SIZE, SLOTS);
+    ret = store_load(store, &record, sizeof(record));
+    if (ret == STORE_ERR_EMPTY)
+        return 0;
+    if (!CHECK_EQ(ret, sizeof(record)))
+        return 0;
+    make_record(&expect, record.count);
+    CHECK(memcmp(&record, &expect, sizeof(record)) == 0);
+    return record.count;
+}
+
+static void test_empty(void)
+{
+    STORE store;
+    RECORD record;
+
+    memset(eeprom, 0xff, sizeof(eeprom));
+    store_init(&store, BASE, SLOT_SIZE, SLOTS);
+    CHECK_EQ(store_load(&store, &record, sizeof(record)), STORE_ERR_EMPTY);
+}
+
+static void test_torn_saves(void)
+{
+    static uint8_t before[sizeof(eeprom)];
+    int length = sizeof(STORE_HEADER) + sizeof(RECORD);
+    STORE store;
+    RECORD record;
+    uint32_t count, found;
+    int at;
+
+    memset(eeprom, 0xff, sizeof(eeprom));
+
+    for (count = 1; count <= SAVES; ++count) {
+        memcpy(before, eeprom, sizeof(eeprom));
+        make_record(&record, count);
+
+        for (at = 0; at < length; ++at) {
+            memcpy(eeprom, before, sizeof(eeprom));
+            CHECK_EQ(reload(&store), count - 1);
+
+            cut = at;
+            store_save(&store, &record, sizeof(record));
+            cut = -1;
+
+            found = reload(&store);
+            CHECK(found == count - 1 || found == count);
+
+            // the next save after the cut has to win
+            make_record(&record, count + 100);
+            CHECK_EQ(store_save(&store, &record, sizeof(record)), sizeof(record));
+            CHECK_EQ(reload(&store), count + 100);
+            make_record(&record, count);
+        }
+
+        // then let it through and carry on from there
+        memcpy(eeprom, before, sizeof(eeprom));
+        reload(&store);
+        CHECK_EQ(store_save(&store, &record, sizeof(record)), sizeof(record));
+        CHECK_EQ(reload(&store), count);
+    }
+}
+
+int main(void)
+{
+    test_empty();
+    test_torn_saves();
+    return test_done("store_test");
+}
@@ -0,0 +1,47 @@
+/**
+ * @file test.h
+ *
+ * @brief Checks shared by the host tests.
+ *
+ * Each test is a plain program built with the host compiler by make test.
+ * A failed CHECK prints where it failed and the test carries on so one run
+ * reports every failure; test_done gives the exit status.
+ */
+
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+
+static int testChecks;
+static int testFailures;
+
+#define CHECK(cond)         test_check((cond), #cond, __FILE__, __LINE__)
+
+// like CHECK but prints the two values when they differ
+#define CHECK_EQ(a, b)      test_check_eq((long)(a), (long)(b), #a, #b, __FILE__, __LINE__)
+
+static inline int test_check(int ok, const char *what, const char *file, int line)
+{
+    ++testChecks;
+    if (!ok && ++testFailures <= 20)
+        printf("%s:%d: check failed: %s\n", file, line, what);
+    return ok;
+}
+
+static inline int test_check_eq(long a, long b, const char *aText, const char *bText, const char *file, int line)
+{
+    ++testChecks;
+    if (a != b && ++testFailures <= 20)
+        printf("%s:%d: check failed: %s == %s (%ld != %ld)\n", file, line, aText, bText, a, b);
+    return a == b;
+}
+
+// prints the summary line, returns the exit status for main
+static inline int test_done(const char *name)
+{
+    printf("%s: %d checks, %d failed\n", name, testChecks, testFailures);
+    return testFailures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * @file ws2812_frames_test.c
+ *
+ * @brief Runs the frame pipeline against a fake driver and checks the
+ * producer never writes a buffer the driver is still reading.
+ *
+ * The fake driver takes the descriptor commands ws2812_update posts on
+ * the host and clears each one as soon as it has latched the descriptor,
+ * earlier than ws2812_driver.spin does, so only the sequence count says
+ * when a buffer is free. It reads the frame one LED at a time while the
+ * producer fills the other buffer. Every LED of a frame holds the frame
+ * number, so a buffer written while it is being read shows up as a torn
+ * frame.
+ */
+
+#include <sched.h>
+#include <propeller.h>
+#include "ws2812.h"
+#include "test.h"
+
+#define LEDS        64
+#define FRAMES      50
+
+static ws2812_t driver;
+static uint32_t buffers[2][LEDS];
+
+static const uint32_t *volatile reading;    // buffer the driver is reading, NULL if none
+static volatile int shown;                  // frames read by the driver
+static volatile int torn;                   // frames that changed while being read
+static volatile int skipped;                // frames shown out of order
+static volatile uint32_t lastFrame;
+
+static void fake_driver(void *par)
+{
+    ws2812_t *state = par;
+    const uint32_t *colors;
+    uint32_t frame;
+    int count, i;
+
+    for (;;) {
+        while (!state->command)
+            sched_yield();
+
+        colors = state->desc.colors;
+        count = state->desc.count;
+        reading = colors;
+        state->command = 0;
+
+        frame = colors[0];
+        for (i = 1; i < count; ++i) {
+            if (colors[i] != frame)
+                ++torn;
+            sched_yield();
+        }
+        reading = NULL;
+
+        if (frame != lastFrame + 1)
+            ++skipped;
+        lastFrame = frame;
+        ++shown;
+
+        ++state->sequence;
+    }
+}
+
+int main(void)
+{
+    static uint32_t stack[64];
+    ws2812_frames_t frames;
+    uint32_t *buf, fence = 0;
+    uint32_t frame;
+    int i;
+
+    ws2812b_init(&driver);
+    CHECK(cogstart(fake_driver, &driver, stack, sizeof(stack)) >= 0);
+    ws2812_frames_init(&frames, &driver, 0, buffers[0], buffers[1], LEDS);
+
+    for (frame = 1; frame <= FRAMES; ++frame) {
+        buf = ws2812_frames_back(&frames);
+        CHECK(buf != reading);
+        for (i = 0; i < LEDS; ++i) {
+            buf[i] = frame;
+            if ((i & 7) == 0)
+                sched_yield();
+        }
+        fence = ws2812_frames_present(&frames);
+        CHECK_EQ(fence, frame);
+    }
+
+    ws2812_wait(&driver, fence);
+    CHECK(ws2812_done(&driver, fence));
+    CHECK_EQ(shown, FRAMES);
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(skipped, 0);
+    CHECK_EQ(lastFrame, FRAMES);
+
+    return test_done("ws2812_frames_test");
+}
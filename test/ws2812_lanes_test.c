@@ -0,0 +1,378 @@
+/**
+ * @file ws2812_lanes_test.c
+ *
+ * @brief Reference model of the multi-lane loop in ws2812_driver.spin.
+ *
+ * The model follows set_lanes, lane_loop and prefetch instruction by
+ * instruction: the same registers, the same stride and lanespan
+ * arithmetic, one lane of the next LED prefetched after the hold of each
+ * bit, and the same fetch code for each array format. It counts cycles
+ * the way the P1 does, 4 for most instructions, 8 for a jump not taken
+ * and 8 plus the wait for the cog's hub window for a hub read, and logs
+ * when each lane's line goes high and low.
+ *
+ * The test decodes the logged waveform back into bits and checks them
+ * against the array for every format, lane count and a range of chain
+ * lengths, checks each entry is read once and nothing outside the array
+ * is, and measures how long the lines stay low between bits.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ws2812.h"
+#include "test.h"
+
+#define CLOCK       80000000
+#define NS(n)       ((uint32_t)((uint64_t)(n) * CLOCK / 1000000000))
+#define NS_OF(t)    ((uint32_t)((uint64_t)(t) * 1000000000 / CLOCK))
+#define HUB_SIZE    4096
+#define PALETTE     3072            // palette address in the model's hub
+#define MAX_LEDS    12
+#define MAX_EDGES   (MAX_LEDS * 32 + 1)
+
+typedef struct {
+    // timing longs, as set by ws_init
+    uint32_t bit0hi, bit0lo, bit1hi, bit1lo, bits;
+} TIMING;
+
+typedef struct {
+    uint8_t hub[HUB_SIZE];
+    int reads[HUB_SIZE];            // hub reads of each byte
+    uint32_t cycle;                 // CNT
+    int hubSlot;                    // CNT & 15 when the cog's hub window opens
+
+    // per lane: time the line went high and low for each bit
+    uint32_t high[WS2812_MAX_LANES][MAX_EDGES];
+    uint32_t low[WS2812_MAX_LANES][MAX_EDGES];
+    int edges;
+} MODEL;
+
+// cog registers the loop uses
+typedef struct {
+    uint32_t bits, preshift, bytes;
+    uint32_t hubpntr, ledcount, nlanes, lanepin, txmask;
+    uint32_t stride, lanespan, laneaddr, pending, bitdelta, zeros;
+    uint32_t addr, colorbits, nleds, nbits, bittimer;
+    uint32_t entrysize, palette;
+    int format;
+    uint32_t lane[WS2812_MAX_LANES], next[WS2812_MAX_LANES];
+    int store;                      // destination field of prefetch_store
+    uint32_t outa;
+} COG;
+
+static void op(MODEL *m)
+{
+    m->cycle += 4;
+}
+
+static void jump(MODEL *m, int taken)
+{
+    m->cycle += taken ? 4 : 8;
+}
+
+static uint32_t hub_read(MODEL *m, uint32_t addr, int size)
+{
+    uint32_t value = 0;
+    int i;
+
+    m->cycle += (m->hubSlot - m->cycle) & 15;
+    m->cycle += 8;
+    if (!CHECK(addr + size <= HUB_SIZE))
+        return 0;
+    for (i = size - 1; i >= 0; --i) {
+        value = (value << 8) | m->hub[addr + i];
+        ++m->reads[addr + i];
+    }
+    return value;
+}
+
+static void waitcnt(MODEL *m, uint32_t target)
+{
+    m->cycle += 6;
+    if ((int32_t)(target + 6 - m->cycle) > 0)
+        m->cycle = target + 6;
+}
+
+// logs the lines that change with the output written by the last instruction
+static void set_outa(MODEL *m, COG *c, uint32_t outa)
+{
+    int n;
+    for (n = 0; n < (int)c->nlanes; ++n) {
+        uint32_t bit = 1 << (c->lanepin + n);
+        if ((outa & bit) && !(c->outa & bit))
+            m->high[n][m->edges] = m->cycle;
+        else if (!(outa & bit) && (c->outa & bit))
+            m->low[n][m->edges] = m->cycle;
+    }
+    c->outa = outa;
+}
+
+// fetch: reads the entry at addr into colorbits, left-justified
+static void fetch(MODEL *m, COG *c)
+{
+    uint32_t t2, t3;
+
+    op(m);                                          // jmp fetchmode
+    switch (c->format) {
+    case WS2812_FORMAT_LONG:
+        c->colorbits = hub_read(m, c->addr, 4);     // rdlong colorbits, addr
+        op(m); c->addr += 4;
+        op(m);                                      // jmp #fetch_done
+        break;
+    case WS2812_FORMAT_PACKED:
+        op(m); t2 = c->bytes;
+        do {
+            t3 = hub_read(m, c->addr, 1);           // rdbyte t3, addr
+            op(m); c->addr += 1;
+            op(m); c->colorbits <<= 8;
+            op(m); c->colorbits |= t3;
+            jump(m, --t2 != 0);                     // djnz t2, #:byte
+        } while (t2);
+        op(m);                                      // jmp #fetch_done
+        break;
+    case WS2812_FORMAT_INDEX:
+        t3 = hub_read(m, c->addr, 1);               // rdbyte t3, addr
+        op(m); c->addr += 1;
+        op(m); t3 <<= 2;
+        op(m); t3 += c->palette;
+        c->colorbits = hub_read(m, t3, 4);          // rdlong colorbits, t3
+        break;
+    }
+    op(m); c->colorbits <<= c->preshift;            // fetch_done
+    op(m);                                          // fetch_ret
+}
+
+static void prefetch(MODEL *m, COG *c)
+{
+    op(m);                                          // call #prefetch
+    op(m); c->addr = c->laneaddr;
+    op(m); fetch(m, c);                             // call #fetch
+    op(m); c->laneaddr += c->stride;
+    op(m); c->next[c->store] = c->colorbits;        // prefetch_store
+    op(m); ++c->store;                              // add prefetch_store, HX_000200
+    op(m); --c->pending;
+    op(m); if (c->pending == 0) c->laneaddr -= c->lanespan;
+    op(m);                                          // prefetch_ret
+}
+
+/*
+ * shifts out count entries on each of lanes lanes starting at pin from the
+ * array at colors in the model's hub, as the driver does for a descriptor
+ */
+static void run(MODEL *m, const TIMING *timing, uint32_t colors, int format, int lanes, int count, int pin)
+{
+    COG c;
+    int n, t2;
+
+    memset(&c, 0, sizeof(c));
+    memset(m->high, 0, sizeof(m->high));
+    memset(m->low, 0, sizeof(m->low));
+    memset(m->reads, 0, sizeof(m->reads));
+    m->edges = 0;
+
+    c.bits = timing->bits;
+    c.preshift = 32 - c.bits;
+    c.bytes = c.bits >> 3;
+    c.hubpntr = colors;
+    c.ledcount = count;
+    c.format = format;
+    c.entrysize = format == WS2812_FORMAT_LONG ? 4 : format == WS2812_FORMAT_PACKED ? c.bytes : 1;
+    c.palette = PALETTE;
+    c.nlanes = lanes;
+    c.lanepin = pin;
+
+    // set_lanes
+    c.txmask = ((1 << c.nlanes) - 1) << c.lanepin;
+    c.stride = 0;
+    for (t2 = c.entrysize; t2; --t2)
+        c.stride += c.ledcount;
+    c.bitdelta = timing->bit1hi - timing->bit0hi;
+    c.lanespan = c.stride;
+    for (t2 = c.nlanes - 1; t2; --t2)
+        c.lanespan += c.stride;
+    c.lanespan -= c.entrysize;
+    c.laneaddr = c.hubpntr;
+    c.nleds = c.ledcount;
+    m->cycle += 17 * 4;
+
+    c.pending = c.nlanes;
+    c.store = 0;
+    op(m); op(m);
+    do {
+        prefetch(m, &c);
+        jump(m, c.pending != 0);
+    } while (c.pending);
+
+    do {
+        // lane_loop
+        for (n = 0; n < WS2812_MAX_LANES; ++n) {
+            op(m);
+            c.lane[n] = c.next[n];
+        }
+        op(m); c.pending = c.nlanes;
+        op(m); c.store = 0;
+        op(m);
+        op(m); if (c.nleds == 1) c.pending = 0;
+        op(m); c.nbits = c.bits;
+
+        do {
+            op(m); c.zeros = 0;
+            for (n = 0; n < WS2812_MAX_LANES; ++n) {
+                op(m);
+                if (!(c.lane[n] & 0x80000000))
+                    c.zeros |= 1 << n;
+                c.lane[n] <<= 1;
+                op(m);
+            }
+            op(m); c.zeros <<= c.lanepin;
+
+            op(m); c.bittimer = timing->bit0hi;
+            op(m); c.bittimer += m->cycle;
+            op(m); set_outa(m, &c, c.outa | c.txmask);
+            waitcnt(m, c.bittimer); c.bittimer += c.bitdelta;
+            op(m); set_outa(m, &c, c.outa & ~c.zeros);
+            waitcnt(m, c.bittimer); c.bittimer += timing->bit1lo;
+            op(m); set_outa(m, &c, c.outa & ~c.txmask);
+            ++m->edges;
+            waitcnt(m, c.bittimer);
+            jump(m, c.pending == 0);                // tjz pending, #:next
+            if (c.pending)
+                prefetch(m, &c);
+            jump(m, --c.nbits != 0);                // djnz nbits, #:loop
+        } while (c.nbits);
+
+        jump(m, --c.nleds != 0);                    // djnz nleds, #lane_loop
+    } while (c.nleds);
+
+    // the lines stay low through the reset time
+    for (n = 0; n < (int)c.nlanes; ++n)
+        m->high[n][m->edges] = m->cycle + NS(50000);
+}
+
+// the wire bits of entry led of lane n, left-justified
+static uint32_t expect_bits(MODEL *m, const TIMING *timing, uint32_t colors, int format, int count, int n, int led)
+{
+    int bytes = timing->bits >> 3, i;
+    uint32_t value = 0;
+
+    switch (format) {
+    case WS2812_FORMAT_LONG:
+        memcpy(&value, &m->hub[colors + 4 * (n * count + led)], 4);
+        break;
+    case WS2812_FORMAT_PACKED:
+        for (i = 0; i < bytes; ++i)
+            value = (value << 8) | m->hub[colors + bytes * (n * count + led) + i];
+        break;
+    case WS2812_FORMAT_INDEX:
+        memcpy(&value, &m->hub[PALETTE + 4 * m->hub[colors + n * count + led]], 4);
+        break;
+    }
+    return value << (32 - timing->bits);
+}
+
+// longest low times after a 0-bit, in cycles
+typedef struct {
+    uint32_t plain;                 // bits with no read after them
+    uint32_t prefetch;              // bits followed by a read of the next LED
+    uint32_t between;               // last bit of an LED
+} LOW_TIMES;
+
+static void longest(uint32_t *max, uint32_t low)
+{
+    if (low > *max)
+        *max = low;
+}
+
+// decodes the waveform and checks it against the array
+static void check_waveform(MODEL *m, const TIMING *timing, uint32_t colors, int format, int lanes, int count, LOW_TIMES *times)
+{
+    uint32_t threshold = (timing->bit0hi + timing->bit1hi) / 2;
+    uint32_t expect, high, low;
+    int n, led, bit, e;
+
+    for (n = 0; n < lanes; ++n) {
+        for (led = 0; led < count; ++led) {
+            expect = expect_bits(m, timing, colors, format, count, n, led);
+            for (bit = 0; bit < (int)timing->bits; ++bit, expect <<= 1) {
+                e = led * timing->bits + bit;
+                high = m->low[n][e] - m->high[n][e];
+                low = m->high[n][e + 1] - m->low[n][e];
+                CHECK_EQ(high > threshold, (expect >> 31) != 0);
+                // within the 150ns the chips allow
+                CHECK(abs((int)high - (int)((expect >> 31) ? timing->bit1hi : timing->bit0hi)) <= (int)NS(150));
+                if (e + 1 == count * (int)timing->bits)
+                    continue;
+                if (bit + 1 == (int)timing->bits)
+                    longest(&times->between, low);
+                else if (bit < lanes && led + 1 < count)
+                    longest(&times->prefetch, low);
+                else
+                    longest(&times->plain, low);
+            }
+        }
+    }
+}
+
+static void fill_hub(MODEL *m)
+{
+    int i;
+    for (i = 0; i < HUB_SIZE; ++i)
+        m->hub[i] = rand();
+}
+
+// checks every entry of the array is read once and nothing else is
+static void check_reads(MODEL *m, uint32_t colors, int format, int lanes, int count, int entrySize)
+{
+    int i, end = colors + lanes * count * entrySize;
+    int palette = format == WS2812_FORMAT_INDEX;
+
+    for (i = 0; i < HUB_SIZE; ++i) {
+        if (i >= (int)colors && i < end)
+            CHECK_EQ(m->reads[i], 1);
+        else if (!(palette && i >= PALETTE && i < PALETTE + 1024))
+            CHECK_EQ(m->reads[i], 0);
+    }
+}
+
+static void test_lanes(const char *name, const TIMING *timing)
+{
+    static const char *formats[3] = { "long", "packed", "index" };
+    static MODEL m;
+    LOW_TIMES times;
+    uint32_t colors = 256;
+    int format, lanes, count, entrySize;
+
+    for (format = 0; format < 3; ++format) {
+        memset(&times, 0, sizeof(times));
+        entrySize = format == WS2812_FORMAT_LONG ? 4 : format == WS2812_FORMAT_PACKED ? (int)timing->bits >> 3 : 1;
+        for (lanes = 1; lanes <= WS2812_MAX_LANES; ++lanes) {
+            for (count = 1; count <= MAX_LEDS; ++count) {
+                fill_hub(&m);
+                m.hubSlot = rand() & 15;
+                m.cycle = rand();
+                run(&m, timing, colors, format, lanes, count, 8);
+                check_waveform(&m, timing, colors, format, lanes, count, &times);
+                check_reads(&m, colors, format, lanes, count, entrySize);
+            }
+        }
+        printf("ws2812_lanes_test: %-8s %-6s longest low %4u ns, %4u ns with a read, %4u ns between LEDs\n",
+               name, formats[format], NS_OF(times.plain), NS_OF(times.prefetch), NS_OF(times.between));
+        CHECK(times.plain < times.prefetch);
+        CHECK(times.prefetch < NS(5000));
+        CHECK(times.between < NS(5000));
+    }
+}
+
+int main(void)
+{
+    // the timings of ws2812_init, ws2812b_init and sk6812_init
+    static const TIMING ws2812 = { NS(350), NS(800), NS(700), NS(600), 24 };
+    static const TIMING ws2812b = { NS(350), NS(900), NS(900), NS(350), 24 };
+    static const TIMING sk6812 = { NS(300), NS(900), NS(600), NS(600), 32 };
+
+    srand(1);
+    test_lanes("ws2812", &ws2812);
+    test_lanes("ws2812b", &ws2812b);
+    test_lanes("sk6812", &sk6812);
+    return test_done("ws2812_lanes_test");
+}
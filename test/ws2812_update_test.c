@@ -0,0 +1,145 @@
+/**
+ * @file ws2812_update_test.c
+ *
+ * @brief Checks how ws2812_update and ws2812_update_format encode their
+ * command longs.
+ *
+ * Nothing here runs a driver: each call is followed by clearing the
+ * command the way the driver does once it has taken it. The color arrays
+ * are never read, so small made up hub addresses stand in for them to
+ * reach the packed form.
+ */
+
+#include <stddef.h>
+#include <propeller.h>
+#include "ws2812.h"
+#include "test.h"
+
+#define HUB(addr)   ((uint32_t *)(uintptr_t)(addr))
+
+static ws2812_t driver;
+
+static uint32_t take_command(void)
+{
+    uint32_t cmd = driver.command;
+    driver.command = 0;
+    return cmd;
+}
+
+static uint32_t desc_command(void)
+{
+    return (uint32_t)(uintptr_t)&driver.desc;
+}
+
+static void check_desc(const void *colors, int count, int pin, int flags, const uint32_t *palette)
+{
+    CHECK_EQ(take_command(), desc_command());
+    CHECK(driver.desc.colors == colors);
+    CHECK_EQ(driver.desc.count, count);
+    CHECK_EQ(driver.desc.pin, pin);
+    CHECK_EQ(driver.desc.flags, flags);
+    CHECK(driver.desc.palette == palette);
+}
+
+static void test_packed(void)
+{
+    int count;
+
+    for (count = 1; count <= WS2812_PACKED_MAX; ++count) {
+        ws2812_update(&driver, 17, HUB(0x7f00), count);
+        CHECK_EQ(take_command(), 17 | ((count - 1) << 8) | (0x7f00 << 16));
+    }
+
+    // the lowest and highest addresses the address field holds
+    ws2812_update(&driver, 0, HUB(0x0004), 1);
+    CHECK_EQ(take_command(), 0x00040000);
+    ws2812_update(&driver, 31, HUB(0xfffc), 256);
+    CHECK_EQ(take_command(), 0xfffcff1f);
+}
+
+static void test_desc(void)
+{
+    uint32_t colors[4];
+
+    // too many LEDs for the count field
+    ws2812_update(&driver, 5, HUB(0x7f00), WS2812_PACKED_MAX + 1);
+    check_desc(HUB(0x7f00), WS2812_PACKED_MAX + 1, 5, 0, NULL);
+    ws2812_update(&driver, 5, HUB(0x7f00), 1000);
+    check_desc(HUB(0x7f00), 1000, 5, 0, NULL);
+
+    // an address above the address field
+    ws2812_update(&driver, 6, HUB(0x10000), 10);
+    check_desc(HUB(0x10000), 10, 6, 0, NULL);
+    ws2812_update(&driver, 6, colors, 4);
+    check_desc(colors, 4, 6, 0, NULL);
+
+    // a packed count of 0 would mean 256 LEDs
+    ws2812_update(&driver, 7, HUB(0x7f00), 0);
+    check_desc(HUB(0x7f00), 0, 7, 0, NULL);
+
+    // chains longer than the descriptor count are cut short, not wrapped
+    ws2812_update(&driver, 8, HUB(0x7f00), WS2812_DESC_MAX);
+    check_desc(HUB(0x7f00), WS2812_DESC_MAX, 8, 0, NULL);
+    ws2812_update(&driver, 8, HUB(0x7f00), WS2812_DESC_MAX + 1);
+    check_desc(HUB(0x7f00), WS2812_DESC_MAX, 8, 0, NULL);
+    ws2812_update(&driver, 8, HUB(0x7f00), -1);
+    check_desc(HUB(0x7f00), 0, 8, 0, NULL);
+}
+
+static void test_format(void)
+{
+    static const uint32_t palette[256];
+    uint8_t indexes[16];
+    int lanes;
+
+    // always a descriptor, even when the packed form would fit
+    ws2812_update_lanes(&driver, 0, HUB(0x7f00), 1, 16);
+    check_desc(HUB(0x7f00), 16, 0, 0, NULL);
+
+    for (lanes = 1; lanes <= WS2812_MAX_LANES; ++lanes) {
+        ws2812_update_format(&driver, 8, indexes, WS2812_FORMAT_INDEX, palette, lanes, 2);
+        check_desc(indexes, 2, 8, (lanes - 1) | (WS2812_FORMAT_INDEX << 3), palette);
+    }
+
+    ws2812_update_format(&driver, 0, indexes, WS2812_FORMAT_PACKED, NULL, 1, 5);
+    check_desc(indexes, 5, 0, WS2812_FORMAT_PACKED << 3, NULL);
+
+    // lanes outside 1 to WS2812_MAX_LANES are clamped, not wrapped
+    ws2812_update_format(&driver, 0, indexes, WS2812_FORMAT_LONG, NULL, 0, 5);
+    check_desc(indexes, 5, 0, 0, NULL);
+    ws2812_update_format(&driver, 0, indexes, WS2812_FORMAT_LONG, NULL, WS2812_MAX_LANES + 1, 5);
+    check_desc(indexes, 5, 0, WS2812_MAX_LANES - 1, NULL);
+}
+
+static void test_fences(void)
+{
+    uint32_t fence;
+
+    driver.posted = 0xfffffffe;
+    driver.sequence = 0xfffffffe;
+    fence = ws2812_update(&driver, 0, HUB(0x7f00), 1);
+    take_command();
+    CHECK_EQ(fence, 0xffffffff);
+    CHECK(!ws2812_done(&driver, fence));
+    fence = ws2812_update(&driver, 0, HUB(0x7f00), 1);
+    take_command();
+    CHECK_EQ(fence, 0);
+
+    // fences keep their order across the wrap
+    driver.sequence = 0xffffffff;
+    CHECK(ws2812_done(&driver, 0xffffffff));
+    CHECK(!ws2812_done(&driver, fence));
+    driver.sequence = 0;
+    CHECK(ws2812_done(&driver, 0xffffffff));
+    CHECK(ws2812_done(&driver, fence));
+}
+
+int main(void)
+{
+    ws2812b_init(&driver);
+    test_packed();
+    test_desc();
+    test_format();
+    test_fences();
+    return test_done("ws2812_update_test");
+}
@@ -11,56 +11,99 @@
  * @brief Driver for WS2812 and WS2812B RGB LEDs.
  */
 
+#include <stddef.h>
 #include <propeller.h>
 #include "ws2812.h"
 
-// driver header structure
-typedef struct {
-    uint32_t    jmp_inst;
-    uint32_t    resettix;
-    uint32_t    bit0hi;
-    uint32_t    bit0lo;
-    uint32_t    bit1hi;
-    uint32_t    bit1lo;
-    uint32_t    swaprg;
-} ws2812_hdr;
-
 // -- usreset is reset timing (us)
 // -- ns0h is 0-bit high timing (ns)
 // -- ns0l is 0-bit low timing (ns)
 // -- ns1h is 1-bit high timing (ns)
 // -- ns1l is 1-bit low timing (ns)
-// -- type is TYPE_GRB for ws2812 or ws2812b
+// -- type is TYPE_GRB for ws2812 or ws2812b, TYPE_GRBW for sk6812
 int ws_init(ws2812_t *state, int usreset, int ns0h, int ns0l, int ns1h, int ns1l, int type)
 {
     extern uint32_t binary_ws2812_driver_dat_start[];
-    ws2812_hdr *hdr = (ws2812_hdr *)binary_ws2812_driver_dat_start;
     uint32_t ustix;
     
     ustix = CLKFREQ / 1000000;          // ticks in 1us
 
-    hdr->resettix = ustix * usreset;
-    hdr->bit0hi   = ustix * ns0h / 1000;
-    hdr->bit0lo   = ustix * ns0l / 1000;
-    hdr->bit1hi   = ustix * ns1h / 1000;
-    hdr->bit1lo   = ustix * ns1l / 1000;
-    hdr->swaprg   = (type == TYPE_GRB);
+    // the driver image is shared so the timing goes in the mailbox
+    state->resettix = ustix * usreset;
+    state->bit0hi   = ustix * ns0h / 1000;
+    state->bit0lo   = ustix * ns0l / 1000;
+    state->bit1hi   = ustix * ns1h / 1000;
+    state->bit1lo   = ustix * ns1l / 1000;
+    state->bits     = (type == TYPE_GRBW ? 32 : 24);
+    state->type     = type;
     
     state->command = 0;
-    state->cog = cognew(hdr, &state->command);
+    state->sequence = 0;
+    state->posted = 0;
+    state->cog = cognew(binary_ws2812_driver_dat_start, &state->command);
     
     return state->cog;
 }
 
-void ws2812_update(ws2812_t *state, int pin, uint32_t *colors, int count)
+// must only be called once the driver has cleared the previous command,
+// chains longer than the count field are cut short rather than wrapped
+static uint32_t desc_cmd(ws2812_t *state, int pin, const void *colors, int count, int flags, const uint32_t *palette)
+{
+    if (count < 0)
+        count = 0;
+    else if (count > WS2812_DESC_MAX)
+        count = WS2812_DESC_MAX;
+    state->desc.colors = colors;
+    state->desc.count = count;
+    state->desc.pin = pin;
+    state->desc.flags = flags;
+    state->desc.palette = palette;
+    return (uint32_t)(uintptr_t)&state->desc;
+}
+
+uint32_t ws2812_update(ws2812_t *state, int pin, uint32_t *colors, int count)
 {
     uint32_t cmd;
-    cmd =  pin
-        | ((count - 1) << 8)
-        | ((uint32_t)colors << 16);
     while (state->command)
         ;
+    if (count > 0 && count <= WS2812_PACKED_MAX && ((uintptr_t)colors >> 16) == 0) {
+        cmd =  pin
+            | ((count - 1) << 8)
+            | ((uint32_t)(uintptr_t)colors << 16);
+    }
+    else
+        cmd = desc_cmd(state, pin, colors, count, 0, NULL);
     state->command = cmd;
+    return ++state->posted;
+}
+
+uint32_t ws2812_update_lanes(ws2812_t *state, int pin, uint32_t *colors, int lanes, int count)
+{
+    return ws2812_update_format(state, pin, colors, WS2812_FORMAT_LONG, NULL, lanes, count);
+}
+
+uint32_t ws2812_update_format(ws2812_t *state, int pin, const void *colors, int format, const uint32_t *palette, int lanes, int count)
+{
+    // keep the lanes inside the 3 bit flag field
+    if (lanes < 1)
+        lanes = 1;
+    else if (lanes > WS2812_MAX_LANES)
+        lanes = WS2812_MAX_LANES;
+    while (state->command)
+        ;
+    state->command = desc_cmd(state, pin, colors, count, WS2812_FLAG_LANES(lanes) | WS2812_FLAG_FORMAT(format), palette);
+    return ++state->posted;
+}
+
+int ws2812_done(ws2812_t *state, uint32_t fence)
+{
+    return (int32_t)(state->sequence - fence) >= 0;
+}
+
+void ws2812_wait(ws2812_t *state, uint32_t fence)
+{
+    while (!ws2812_done(state, fence))
+        ;
 }
 
 /**
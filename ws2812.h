@@ -22,8 +22,14 @@ extern "C" {
 
 #define TYPE_RGB            0
 #define TYPE_GRB            1   // for WS2812 and WS2812B
+#define TYPE_GRBW           2   // for SK6812 RGBW
 
 #define COLOR(r, g, b)      (((r) << 16) | ((g) << 8) | (b))
+
+// colors in wire order for each type
+#define COLOR_RGB(r, g, b)      COLOR(r, g, b)
+#define COLOR_GRB(r, g, b)      (((g) << 16) | ((r) << 8) | (b))
+#define COLOR_GRBW(r, g, b, w)  (((g) << 24) | ((r) << 16) | ((b) << 8) | (w))
 #define SCALE(x, l)         ((x) * (l) / 255)
 #define COLORX(r, g, b, l)  ((SCALE(r, l) << 16) | (SCALE(g, l) << 8) | SCALE(b, l))
 
@@ -49,12 +55,62 @@ extern "C" {
 #define COLOR_CRIMSON    0xDC283C
 #define COLOR_PURPLE     0x8C00FF
 
+// largest chain that fits in a packed command long
+#define WS2812_PACKED_MAX   256
+
+// largest chain that fits in an update descriptor
+#define WS2812_DESC_MAX     65535
+
+// most chains that can be shifted out in lockstep
+#define WS2812_MAX_LANES    8
+
+// frame buffer formats
+#define WS2812_FORMAT_LONG      0   // one uint32_t per LED in wire order
+#define WS2812_FORMAT_PACKED    1   // bits / 8 bytes per LED in wire order, msb first
+#define WS2812_FORMAT_INDEX     2   // one byte per LED indexing a 256 entry palette
+
+// descriptor flags
+#define WS2812_FLAG_LANES(n)    (((n) - 1) & 7)
+#define WS2812_FLAG_FORMAT(f)   (((f) & 3) << 3)
+
+// update descriptor for chains that don't fit in a packed command long
+typedef struct {
+    const void *colors;         // array of colors, one for each LED in the chain
+    uint16_t count;             // number of LEDs in the chain
+    uint8_t pin;                // pin connected to the first LED
+    uint8_t flags;              // WS2812_FLAG_xxx
+    const uint32_t *palette;    // wire order colors for WS2812_FORMAT_INDEX
+} ws2812_desc_t;
+
 // driver state structure
 typedef struct {
     volatile uint32_t command;
+    volatile uint32_t sequence; // number of frames consumed by the driver
+
+    // timing read by the driver when it starts
+    uint32_t resettix;          // reset timing (ticks)
+    uint32_t bit0hi;            // 0-bit high timing (ticks)
+    uint32_t bit0lo;            // 0-bit low timing (ticks)
+    uint32_t bit1hi;            // 1-bit high timing (ticks)
+    uint32_t bit1lo;            // 1-bit low timing (ticks)
+    uint32_t bits;              // bits per LED (24 or 32)
+
+    int type;                   // color format (TYPE_xxx)
+    uint32_t posted;            // number of frames posted to the driver
+    ws2812_desc_t desc;         // descriptor for the command in progress
     int cog;
 } ws2812_t;
 
+// double-buffered frame pipeline
+typedef struct {
+    ws2812_t *driver;
+    int pin;
+    int count;
+    uint32_t *buffers[2];
+    uint32_t fences[2];
+    int back;
+} ws2812_frames_t;
+
 /**
  * @brief Initialize a driver for WS2812 chips
  *
@@ -71,15 +127,27 @@ int ws2812_init(ws2812_t *driver);
  */
 int ws2812b_init(ws2812_t *driver);
 
+/**
+ * @brief Initialize a driver for SK6812 RGBW chips
+ *
+ * @param driver Pointer to a driver structure
+ * @returns Driver COG number or -1 on failure
+ */
+int sk6812_init(ws2812_t *driver);
+
 /**
  * @brief Load a COG with a driver using custom parameters
  *
+ * @detail The timing is kept in the driver structure so drivers for
+ * different chip types can run at the same time on separate COGs.
+ *
+ * @param driver Pointer to a driver structure
  * @param usreset Reset timing (us)
  * @param ns0h 0-bit high timing (ns)
  * @param ns0l 0-bit low timing (ns)
  * @param ns1h 1-bit high timing (ns)
  * @param ns1l 1-bit low timing (ns)
- * @param type color format (either TYPE_RGB or TYPE_GRB)
+ * @param type color format (TYPE_RGB, TYPE_GRB or TYPE_GRBW)
  * @returns Driver COG number or -1 on failure
  */
 int ws_init(ws2812_t *driver, int usreset, int ns0h, int ns0l, int ns1h, int ns1l, int type);
@@ -94,12 +162,134 @@ void ws2812_term(ws2812_t *driver);
 /**
  * @brief Update a chain of LEDs
  *
+ * @detail Returns as soon as the driver has accepted the command. The colors
+ * array must not be modified until the returned fence has completed. Colors
+ * must already be in wire order (see ws2812_pixel). Chains
+ * of up to WS2812_PACKED_MAX LEDs are sent as a packed command long, longer
+ * chains (up to WS2812_DESC_MAX LEDs) through the update descriptor.
+ *
  * @param driver Pointer to the driver structure
  * @param pin Pin connected to the first LED
  * @param colors Array of colors, one for each LED in the chain
  * @param count Number of LEDs in the chain
+ * @returns Fence that completes when the driver has consumed the colors array
+ */
+uint32_t ws2812_update(ws2812_t *driver, int pin, uint32_t *colors, int count);
+
+/**
+ * @brief Update up to WS2812_MAX_LANES chains of LEDs in parallel
+ *
+ * @detail Lane n is connected to pin + n and its colors are the n-th run of
+ * count entries in the colors array. All lanes are shifted out in lockstep,
+ * so updating eight chains takes about as long as updating one.
+ *
+ * @param driver Pointer to the driver structure
+ * @param pin Pin connected to the first LED of lane 0
+ * @param colors Array of colors, count entries for each lane
+ * @param lanes Number of lanes, clamped to 1 to WS2812_MAX_LANES
+ * @param count Number of LEDs in each lane, clamped to 0 to WS2812_DESC_MAX
+ * @returns Fence that completes when the driver has consumed the colors array
+ */
+uint32_t ws2812_update_lanes(ws2812_t *driver, int pin, uint32_t *colors, int lanes, int count);
+
+/**
+ * @brief Update chains of LEDs from a compact frame buffer
+ *
+ * @detail The driver expands each entry to wire order as it shifts it out,
+ * so a WS2812_FORMAT_PACKED buffer takes 3 bytes per 24 bit LED and a
+ * WS2812_FORMAT_INDEX buffer takes 1 byte per LED plus the palette. Lanes
+ * are laid out as for ws2812_update_lanes.
+ *
+ * @param driver Pointer to the driver structure
+ * @param pin Pin connected to the first LED of lane 0
+ * @param colors Array of entries in the given format, count for each lane
+ * @param format Format of the entries (WS2812_FORMAT_xxx)
+ * @param palette 256 colors in wire order for WS2812_FORMAT_INDEX
+ * @param lanes Number of lanes, clamped to 1 to WS2812_MAX_LANES
+ * @param count Number of LEDs in each lane, clamped to 0 to WS2812_DESC_MAX
+ * @returns Fence that completes when the driver has consumed the colors array
+ */
+uint32_t ws2812_update_format(ws2812_t *driver, int pin, const void *colors, int format, const uint32_t *palette, int lanes, int count);
+
+/**
+ * @brief Check whether a frame has been consumed by the driver
+ *
+ * @param driver Pointer to the driver structure
+ * @param fence Fence returned by ws2812_update
+ * @returns Non-zero if the driver has finished reading the frame
+ */
+int ws2812_done(ws2812_t *driver, uint32_t fence);
+
+/**
+ * @brief Wait until a frame has been consumed by the driver
+ *
+ * @param driver Pointer to the driver structure
+ * @param fence Fence returned by ws2812_update
+ */
+void ws2812_wait(ws2812_t *driver, uint32_t fence);
+
+/**
+ * @brief Initialize a double-buffered frame pipeline
+ *
+ * @detail The renderer fills the back buffer while the driver shifts out
+ * the front buffer.
+ *
+ * @param frames Pointer to the pipeline structure
+ * @param driver Pointer to the driver structure
+ * @param pin Pin connected to the first LED
+ * @param buf0 First frame buffer
+ * @param buf1 Second frame buffer
+ * @param count Number of LEDs in the chain
+ */
+void ws2812_frames_init(ws2812_frames_t *frames, ws2812_t *driver, int pin, uint32_t *buf0, uint32_t *buf1, int count);
+
+/**
+ * @brief Get the back buffer, waiting until the driver is done with it
+ *
+ * @param frames Pointer to the pipeline structure
+ * @returns Frame buffer that is safe to render into
+ */
+uint32_t *ws2812_frames_back(ws2812_frames_t *frames);
+
+/**
+ * @brief Post the back buffer to the driver and swap buffers
+ *
+ * @param frames Pointer to the pipeline structure
+ * @returns Fence that completes when the driver has consumed the frame
+ */
+uint32_t ws2812_frames_present(ws2812_frames_t *frames);
+
+/**
+ * @brief Convert a color to wire order
+ *
+ * @detail For TYPE_GRBW the white channel is taken from the common part of
+ * red, green and blue.
+ *
+ * @param type color format of the chain (TYPE_xxx)
+ * @param color Color in $RRGGBB form
+ * @returns Color in the order the driver shifts it out
+ */
+uint32_t ws2812_pixel(int type, uint32_t color);
+
+/**
+ * @brief Convert an array of colors to wire order
+ *
+ * @param type color format of the chain (TYPE_xxx)
+ * @param dst Array of converted colors (may be the same as src)
+ * @param src Array of colors in $RRGGBB form
+ * @param count Number of colors to convert
+ */
+void ws2812_convert(int type, uint32_t *dst, const uint32_t *src, int count);
+
+/**
+ * @brief Pack wire order colors into a WS2812_FORMAT_PACKED buffer
+ *
+ * @param driver Pointer to the driver structure, gives the bytes per LED
+ * @param dst Packed buffer, driver->bits / 8 bytes for each color
+ * @param src Array of colors in wire order
+ * @param count Number of colors to pack
  */
-void ws2812_update(ws2812_t *driver, int pin, uint32_t *colors, int count);
+void ws2812_pack(ws2812_t *driver, uint8_t *dst, const uint32_t *src, int count);
 
 /**
  * @brief Create color from a 0 to 255 position input
@@ -0,0 +1,78 @@
+/**
+ * @file ws2812_format.c
+ *
+ * @author David Betz
+ *
+ * @version 0.01
+ *
+ * @copyright
+ * Copyright (c) David Betz 2014, All Rights MIT Licensed.
+ *
+ * @brief Color format conversion for WS2812 and SK6812 LEDs.
+ */
+
+#include "ws2812.h"
+
+uint32_t ws2812_pixel(int type, uint32_t color)
+{
+    uint32_t r = (color >> 16) & 0xff;
+    uint32_t g = (color >> 8) & 0xff;
+    uint32_t b = color & 0xff;
+    uint32_t w;
+
+    switch (type) {
+    case TYPE_GRB:
+        return COLOR_GRB(r, g, b);
+    case TYPE_GRBW:
+        w = r < g ? r : g;
+        if (b < w)
+            w = b;
+        return COLOR_GRBW(r - w, g - w, b - w, w);
+    default:
+        return COLOR_RGB(r, g, b);
+    }
+}
+
+void ws2812_convert(int type, uint32_t *dst, const uint32_t *src, int count)
+{
+    int i;
+    if (type == TYPE_RGB) {
+        for (i = 0; i < count; ++i)
+            dst[i] = src[i] & 0xffffff;
+    }
+    else {
+        for (i = 0; i < count; ++i)
+            dst[i] = ws2812_pixel(type, src[i]);
+    }
+}
+
+void ws2812_pack(ws2812_t *driver, uint8_t *dst, const uint32_t *src, int count)
+{
+    int shift, i;
+    for (i = 0; i < count; ++i) {
+        for (shift = driver->bits - 8; shift >= 0; shift -= 8)
+            *dst++ = src[i] >> shift;
+    }
+}
+
+/**
+ * TERMS OF USE: MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
@@ -0,0 +1,63 @@
+/**
+ * @file ws2812_frames.c
+ *
+ * @author David Betz
+ *
+ * @version 0.01
+ *
+ * @copyright
+ * Copyright (c) David Betz 2014, All Rights MIT Licensed.
+ *
+ * @brief Double-buffered frame pipeline for WS2812 drivers.
+ */
+
+#include "ws2812.h"
+
+void ws2812_frames_init(ws2812_frames_t *frames, ws2812_t *driver, int pin, uint32_t *buf0, uint32_t *buf1, int count)
+{
+    frames->driver = driver;
+    frames->pin = pin;
+    frames->count = count;
+    frames->buffers[0] = buf0;
+    frames->buffers[1] = buf1;
+    frames->fences[0] = driver->posted;
+    frames->fences[1] = driver->posted;
+    frames->back = 0;
+}
+
+uint32_t *ws2812_frames_back(ws2812_frames_t *frames)
+{
+    // the driver may still be shifting out this buffer from two frames ago
+    ws2812_wait(frames->driver, frames->fences[frames->back]);
+    return frames->buffers[frames->back];
+}
+
+uint32_t ws2812_frames_present(ws2812_frames_t *frames)
+{
+    int back = frames->back;
+    frames->fences[back] = ws2812_update(frames->driver, frames->pin, frames->buffers[back], frames->count);
+    frames->back = back ^ 1;
+    return frames->fences[back];
+}
+
+/**
+ * TERMS OF USE: MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */